@@ -26,7 +26,8 @@ XBART_cpp_module = Extension('_xbart_cpp_',
                                       "src/sample_int_crank.cpp",
                                       "src/common.cpp",  
                                       "src/tree.cpp", "src/thread_pool.cpp",
-                                      "src/cdf.cpp", "src/json_io.cpp","src/model.cpp"
+                                      "src/cdf.cpp", "src/json_io.cpp","src/model.cpp",
+                                      "src/compiled_forest.cpp", "src/gp_predict.cpp"
                                       ],
                              language="c++",
                              include_dirs=[
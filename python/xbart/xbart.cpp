@@ -15,9 +15,11 @@ XBARTcpp::XBARTcpp(XBARTcppParams params)
 XBARTcpp::XBARTcpp(std::string json_string)
 {
 	// std::vector<std::vector<tree>> temp_trees;
-	from_json_to_forest(json_string, this->trees, this->y_mean);
+	std::vector<size_t> chain;
+	from_json_to_forest(json_string, this->trees, this->y_mean, chain, this->p);
 	this->params.num_sweeps = this->trees.size();
 	this->params.num_trees = this->trees[0].size();
+	this->forest.compile(this->trees);
 }
 
 XBARTcpp::XBARTcpp(size_t num_trees, size_t num_sweeps, size_t max_depth,
@@ -82,7 +84,7 @@ XBARTcpp::XBARTcpp(size_t num_trees, size_t num_sweeps, size_t max_depth,
 
 std::string XBARTcpp::_to_json(void)
 {
-	json j = get_forest_json(this->trees, this->y_mean);
+	json j = get_forest_json(this->trees, this->y_mean, std::vector<size_t>(), this->p);
 	return j.dump();
 }
 
@@ -194,98 +196,56 @@ void XBARTcpp::_get_importance(int size, double *arr)
 void XBARTcpp::_predict(int n, int p, double *a)
 { //,int size, double *arr){
 
-	// Convert *a to col_major std::vector
-	vec_d x_test_std_flat(n * p);
-	XBARTcpp::np_to_col_major_vec(n, p, a, x_test_std_flat);
+	// Initialize result, reuse containers if size does not change
+	if (this->yhats_test_xinfo.size() != this->params.num_sweeps || this->yhats_test_xinfo[0].size() != (size_t)n)
+	{
+		ini_matrix(this->yhats_test_xinfo, n, this->params.num_sweeps);
+	}
 
-	// Initialize result
-	ini_matrix(this->yhats_test_xinfo, n, this->params.num_sweeps);
+	// a is row major, each row is contiguous
+	std::vector<double> yhat(this->params.num_sweeps);
 	for (size_t i = 0; i < n; i++)
 	{
+		this->forest.predict_one(a + i * p, &yhat[0]);
 		for (size_t j = 0; j < this->params.num_sweeps; j++)
 		{
-			this->yhats_test_xinfo[j][i] = 0;
+			this->yhats_test_xinfo[j][i] = yhat[j];
 		}
 	}
-
-	// Convert column major vector to pointer
-	const double *Xtestpointer = &x_test_std_flat[0]; //&x_test_std[0][0];
-
-	// Predict
-	NormalModel *model = new NormalModel(); //(this->params.kap, this->params.s, this->params.tau, this->params.alpha, this->params.beta);
-
-	model->predict_std(Xtestpointer, n, p, this->params.num_trees, this->params.num_sweeps,
-					   this->yhats_test_xinfo, this->trees); // *trees2
-
-	delete model;
 }
 
-void XBARTcpp::_predict_gp(int n, int d, double *a, int n_y, double *a_y, int n_t, int d_t, double *a_t, size_t p_cat, double theta, double tau)
+void XBARTcpp::_predict_one(int n, double *a, int size, double *arr)
 {
-
-	// Convert row major *a to column major std::vector
-	vec_d x_std_flat(n * d);
-	XBARTcpp::np_to_col_major_vec(n, d, a, x_std_flat);
-
-	// Convert row major *a_t to column major std::vector
-	vec_d xtest_std_flat(n_t * d_t);
-	XBARTcpp::np_to_col_major_vec(n_t, d_t, a_t, xtest_std_flat);
-
-	// Convert a_y to std::vector
-	vec_d y_std(n);
-	XBARTcpp::np_to_vec_d(n, a_y, y_std);
-
-	// Calculate y_mean
-	double y_mean = 0.0;
-	for (size_t i = 0; i < n; i++)
+	// predict a single row a of length p, arr has length num_sweeps
+	// does not allocate, can be called concurrently after fit
+	if ((size_t)n < this->forest.p || (this->p > 0 && (size_t)n != this->p) || (size_t)size != this->params.num_sweeps)
 	{
-		y_mean = y_mean + y_std[i];
+		throw std::invalid_argument("row length should be the number of columns of the training data and size the number of sweeps");
 	}
-	y_mean = y_mean / (double)n;
-	this->y_mean = y_mean;
-
-	// xorder containers
-	matrix<size_t> Xorder_std;
-	ini_xinfo_sizet(Xorder_std, n, d);
-	XBARTcpp::compute_Xorder(n, d, x_std_flat, Xorder_std);
-
-	// xtestorder containers
-	matrix<size_t> Xtestorder_std;
-	ini_xinfo_sizet(Xtestorder_std, n_t, d_t);
-	XBARTcpp::compute_Xorder(n_t, d_t, xtest_std_flat, Xtestorder_std);
-
-	// //max_depth_std container
-	// matrix<size_t> max_depth_std;
-	// ini_xinfo_sizet(max_depth_std, this->params.num_trees, this->params.num_sweeps);
-
-	// // Fill with max Depth Value
-	// for(size_t i = 0; i < this->params.num_trees; i++){
-	// 	for(size_t j = 0;j < this->params.num_sweeps; j++){
-	// 		max_depth_std[j][i] = this->params.max_depth;
-	// 	}
-	// }
-
-	// // Cpp native objects to return
-	// matrix<double>  yhats_xinfo; // Temp Change
-	// ini_xinfo(yhats_xinfo, n_t, this->params.num_sweeps);
-
-	// Temp Change
-	// ini_xinfo(this->sigma_draw_xinfo, this->params.num_trees, this->params.num_sweeps);
-	// this->mtry_weight_current_tree.resize(p);
-	// ini_xinfo(this->split_count_all_tree, d, this->params.M); // initialize at 0
+	this->forest.predict_one(a, arr);
+}
 
-	double *ypointer = &a_y[0];
-	double *Xpointer = &x_std_flat[0];
-	double *Xtestpointer = &xtest_std_flat[0];
+void XBARTcpp::_predict_gp(int n, int d, double *a, int n_y, double *a_y, int n_t, int d_t, double *a_t, size_t p_cat, double theta, double tau, size_t max_train)
+{
+	// training data a and testing data a_t are row major, as gp_predict_forest expects
+	if (d_t != d || (size_t)d < this->forest.p || (this->p > 0 && (size_t)d != this->p))
+	{
+		throw std::invalid_argument("training and testing data should have the number of columns of the training data");
+	}
+	if (n_y != n || (size_t)n * this->params.num_sweeps * this->params.num_trees != this->resid.size())
+	{
+		throw std::invalid_argument("training data should be the data the model was fitted on");
+	}
+	if (max_train == 0)
+	{
+		throw std::invalid_argument("max_train should be positive");
+	}
 
 	// Initialize result
 	ini_matrix(this->yhats_test_xinfo, n_t, this->params.num_sweeps);
-	for (size_t i = 0; i < n_t; i++)
+	for (size_t j = 0; j < this->params.num_sweeps; j++)
 	{
-		for (size_t j = 0; j < this->params.num_sweeps; j++)
-		{
-			this->yhats_test_xinfo[j][i] = 0;
-		}
+		std::fill(this->yhats_test_xinfo[j].begin(), this->yhats_test_xinfo[j].end(), 0.0);
 	}
 
 	std::vector<double> sigma_std(this->params.num_sweeps);
@@ -294,16 +254,6 @@ void XBARTcpp::_predict_gp(int n, int d, double *a, int n_y, double *a_y, int n_
 		sigma_std[i] = this->sigma_draw_xinfo[i][this->params.num_trees - 1];
 	}
 
-	// initialize X_struct
-	std::vector<double> initial_theta(1, y_mean / (double)this->params.num_trees);
-	gp_struct x_struct(new gp_struct(Xpointer, &y_std, n, Xorder_std, p_cat, d - p_cat, &initial_theta, sigma_std, this->params.num_trees));
-	gp_struct xtest_struct(new gp_struct(Xtestpointer, &y_std, n_t, Xtestorder_std, p_cat, d - p_cat, &initial_theta, sigma_std, this->params.num_trees));
-	x_struct.n_y = n;
-	xtest_struct.n_y = n_t;
-
-	std::vector<bool> active_var(d);
-	std::fill(active_var.begin(), active_var.end(), false);
-
 	// get residuals
 	matrix<std::vector<double>> residuals;
 	ini_matrix(residuals, this->params.num_trees, this->params.num_sweeps);
@@ -318,21 +268,10 @@ void XBARTcpp::_predict_gp(int n, int d, double *a, int n_y, double *a_y, int n_
 			}
 		}
 	}
-	x_struct.set_resid(residuals);
 
-	// mcmc loop
-	for (size_t sweeps = 0; sweeps < this->params.num_sweeps; sweeps++)
-	{
-		for (size_t tree_ind = 0; tree_ind < this->params.num_trees; tree_ind++)
-		{
-			(this->trees)[sweeps][tree_ind].gp_predict_from_root(Xorder_std, x_struct, x_struct.X_counts, x_struct.X_num_unique,
-																 Xtestorder_std, xtest_struct, xtest_struct.X_counts, xtest_struct.X_num_unique,
-																 this->yhats_test_xinfo, active_var, p_cat, sweeps, tree_ind, theta, tau);
-		}
-	}
-
-	// x_struct.reset();
-	// xtest_struct.reset();
+	std::random_device rd;
+	size_t seed = this->seed_flag ? this->seed : rd();
+	gp_predict_forest(this->forest, a, n, a_t, n_t, d, p_cat, residuals, sigma_std, theta, tau, max_train, this->params.parallel, seed, this->yhats_test_xinfo);
 }
 
 // void XBARTcpp::_predict_multinomial(int n, int d, double *a){//,int size, double *arr){
@@ -440,6 +379,9 @@ void XBARTcpp::_fit(int n, int p, double *a, int n_y, double *a_y, size_t p_cat)
 
 	this->mtry_weight_current_tree = (*state.mtry_weight_current_tree);
 
+	this->forest.compile(this->trees);
+	this->p = p;
+
 	// delete model;
 	//    state.reset();
 	// x_struct.reset();
@@ -3,6 +3,8 @@
 #include <mcmc_loop.h>
 #include <json_io.h>
 #include <model.h>
+#include <compiled_forest.h>
+#include <gp_predict.h>
 #include <armadillo>
 
 struct XBARTcppParams
@@ -34,10 +36,11 @@ class XBARTcpp
 public:
 	XBARTcppParams params;
 	vector<vector<tree>> trees;
+	compiled_forest forest; // flat copy of trees for prediction
 	double y_mean;
 	size_t n_train;
 	size_t n_test;
-	size_t p;
+	size_t p = 0; // number of columns of the training data, 0 for json models saved without it
 	matrix<double> yhats_xinfo;
 	matrix<double>  yhats_test_xinfo;
 	matrix<double>  sigma_draw_xinfo;
@@ -66,7 +69,8 @@ public:
 
 	void _fit(int n, int d, double *a, int n_y, double *a_y, size_t p_cat);
 	void _predict(int n, int d, double *a); //,int size, double *arr);
-	void _predict_gp(int n, int d, double *a, int n_y, double *a_y, int n_t, int d_t, double *a_t, size_t p_cat, double theta, double tau);
+	void _predict_one(int n, double *a, int size, double *arr);
+	void _predict_gp(int n, int d, double *a, int n_y, double *a_y, int n_t, int d_t, double *a_t, size_t p_cat, double theta, double tau, size_t max_train);
 
 	// helper functions
 	void np_to_vec_d(int n, double *a, vec_d &y_std);
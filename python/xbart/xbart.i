@@ -27,6 +27,23 @@ import_array();
 %apply (int DIM1,double* IN_ARRAY1) {(int n_y,double *a_y)};
 
 
+/* row length of _predict_one and data shapes of _predict_gp are checked in C++ */
+%exception XBARTcpp::_predict_one {
+	try {
+		$action
+	} catch (const std::invalid_argument &e) {
+		SWIG_exception_fail(SWIG_ValueError, e.what());
+	}
+}
+
+%exception XBARTcpp::_predict_gp {
+	try {
+		$action
+	} catch (const std::invalid_argument &e) {
+		SWIG_exception_fail(SWIG_ValueError, e.what());
+	}
+}
+
 %include "xbart.h" // Include code for a static version of Python
 
 
@@ -116,8 +116,11 @@ class XBARTcpp(object):
     def _predict(self, n: "int") -> "void":
         return _xbart_cpp_.XBARTcpp__predict(self, n)
 
-    def _predict_gp(self, n: "int", n_y: "int", n_t: "int", p_cat: "size_t", theta: "double", tau: "double") -> "void":
-        return _xbart_cpp_.XBARTcpp__predict_gp(self, n, n_y, n_t, p_cat, theta, tau)
+    def _predict_one(self, n: "int", size: "int") -> "void":
+        return _xbart_cpp_.XBARTcpp__predict_one(self, n, size)
+
+    def _predict_gp(self, n: "int", n_y: "int", n_t: "int", p_cat: "size_t", theta: "double", tau: "double", max_train: "size_t") -> "void":
+        return _xbart_cpp_.XBARTcpp__predict_gp(self, n, n_y, n_t, p_cat, theta, tau, max_train)
 
     def np_to_vec_d(self, n: "int", y_std: "vec_d &") -> "void":
         return _xbart_cpp_.XBARTcpp_np_to_vec_d(self, n, y_std)
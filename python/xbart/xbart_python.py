@@ -364,6 +364,32 @@ class XBART(object):
 		else:
 			return self.yhats_test
 
+	def predict_one(self,x_row,return_mean = True):
+		'''
+		Predict a single observation with XBART model
+        Parameters
+        ----------
+		x_row : numpy array
+            Feature vector of one observation (length p)
+		return_mean: bool
+			If true, will return mean prediction, else will return (num_sweeps) "posterior" estimate
+	
+		Returns
+        -------
+        prediction : float or numpy array
+		'''
+
+		assert self.is_fit, "Must run fit before running predict"
+
+		x_row = np.ascontiguousarray(x_row, dtype = np.float64).ravel()
+		assert x_row.shape[0] == self.num_columns, "Mismatch on number of columns"
+		yhats = self._xbart_cpp._predict_one(x_row, self.params["num_sweeps"])
+
+		if return_mean:
+			return yhats[self.params["burnin"]:].mean()
+		else:
+			return yhats
+
 	def fit_predict(self,x,y,x_test,p_cat=0,return_mean=True):	
 		'''
 		Fit and predict XBART model
@@ -388,13 +414,15 @@ class XBART(object):
 		self.fit(x,y,p_cat)
 		return self.predict(x_test,return_mean)
 
-	def predict_gp(self, x, y, x_test, p_cat = 0, theta = 10, tau = "auto", return_mean = True):
+	def predict_gp(self, x, y, x_test, p_cat = 0, theta = 10, tau = "auto", max_train = 100, return_mean = True):
 		'''
 		Predict XBART model
         Parameters
         ----------
 		x_test : DataFrame or numpy array
             Feature matrix (predictors)
+		max_train: int
+			Leaves with more training observations use a low-rank approximation with max_train inducing points
 		return_mean: bool
 			If true, will return mean prediction, else will return (n X num_sweeps) "posterior" estimate
 	
@@ -426,7 +454,7 @@ class XBART(object):
 		self.__check_params(p_cat)
 		# self.__update_random_seed()
 
-		self._xbart_cpp._predict_gp(fit_x, fit_y, pred_x, p_cat, theta, tau)
+		self._xbart_cpp._predict_gp(fit_x, fit_y, pred_x, p_cat, theta, tau, int(max_train))
 		# # Convert to numpy
 		yhats_test = self._xbart_cpp.get_yhats_test(self.params["num_sweeps"]*pred_x.shape[0])
 		# # Convert from colum major 
@@ -6276,6 +6276,83 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_XBARTcpp__predict_one(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
+  PyObject *resultobj = 0;
+  XBARTcpp *arg1 = (XBARTcpp *) 0 ;
+  int arg2 ;
+  double *arg3 = (double *) 0 ;
+  int arg4 ;
+  double *arg5 = (double *) 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  PyArrayObject *array2 = NULL ;
+  int is_new_object2 = 0 ;
+  PyObject *array4 = NULL ;
+  PyObject *swig_obj[3] ;
+  
+  if (!SWIG_Python_UnpackTuple(args, "XBARTcpp__predict_one", 3, 3, swig_obj)) SWIG_fail;
+  res1 = SWIG_ConvertPtr(swig_obj[0], &argp1,SWIGTYPE_p_XBARTcpp, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "XBARTcpp__predict_one" "', argument " "1"" of type '" "XBARTcpp *""'"); 
+  }
+  arg1 = reinterpret_cast< XBARTcpp * >(argp1);
+  {
+    npy_intp size[1] = {
+      -1
+    };
+    array2 = obj_to_array_contiguous_allow_conversion(swig_obj[1],
+      NPY_DOUBLE,
+      &is_new_object2);
+    if (!array2 || !require_dimensions(array2, 1) ||
+      !require_size(array2, size, 1)) SWIG_fail;
+    arg2 = (int) array_size(array2,0);
+    arg3 = (double*) array_data(array2);
+  }
+  {
+    npy_intp dims[1];
+    if (!PyInt_Check(swig_obj[2]))
+    {
+      const char* typestring = pytype_string(swig_obj[2]);
+      PyErr_Format(PyExc_TypeError,
+        "Int dimension expected.  '%s' given.",
+        typestring);
+      SWIG_fail;
+    }
+    arg4 = (int) PyInt_AsLong(swig_obj[2]);
+    dims[0] = (npy_intp) arg4;
+    array4 = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    if (!array4) SWIG_fail;
+    arg5 = (double*) array_data(array4);
+  }
+  {
+    try {
+      (arg1)->_predict_one(arg2,arg3,arg4,arg5);
+    } catch (const std::invalid_argument &e) {
+      SWIG_exception_fail(SWIG_ValueError, e.what());
+    }
+  }
+  resultobj = SWIG_Py_Void();
+  {
+    resultobj = SWIG_Python_AppendOutput(resultobj,(PyObject*)array4);
+  }
+  {
+    if (is_new_object2 && array2)
+    {
+      Py_DECREF(array2); 
+    }
+  }
+  return resultobj;
+fail:
+  {
+    if (is_new_object2 && array2)
+    {
+      Py_DECREF(array2); 
+    }
+  }
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_XBARTcpp__predict_gp(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
   PyObject *resultobj = 0;
   XBARTcpp *arg1 = (XBARTcpp *) 0 ;
@@ -6290,6 +6367,7 @@ SWIGINTERN PyObject *_wrap_XBARTcpp__predict_gp(PyObject *SWIGUNUSEDPARM(self),
   size_t arg10 ;
   double arg11 ;
   double arg12 ;
+  size_t arg13 ;
   void *argp1 = 0 ;
   int res1 = 0 ;
   PyArrayObject *array2 = NULL ;
@@ -6304,9 +6382,11 @@ SWIGINTERN PyObject *_wrap_XBARTcpp__predict_gp(PyObject *SWIGUNUSEDPARM(self),
   int ecode11 = 0 ;
   double val12 ;
   int ecode12 = 0 ;
-  PyObject *swig_obj[7] ;
+  size_t val13 ;
+  int ecode13 = 0 ;
+  PyObject *swig_obj[8] ;
   
-  if (!SWIG_Python_UnpackTuple(args, "XBARTcpp__predict_gp", 7, 7, swig_obj)) SWIG_fail;
+  if (!SWIG_Python_UnpackTuple(args, "XBARTcpp__predict_gp", 8, 8, swig_obj)) SWIG_fail;
   res1 = SWIG_ConvertPtr(swig_obj[0], &argp1,SWIGTYPE_p_XBARTcpp, 0 |  0 );
   if (!SWIG_IsOK(res1)) {
     SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "XBARTcpp__predict_gp" "', argument " "1"" of type '" "XBARTcpp *""'"); 
@@ -6365,7 +6445,18 @@ SWIGINTERN PyObject *_wrap_XBARTcpp__predict_gp(PyObject *SWIGUNUSEDPARM(self),
     SWIG_exception_fail(SWIG_ArgError(ecode12), "in method '" "XBARTcpp__predict_gp" "', argument " "12"" of type '" "double""'");
   } 
   arg12 = static_cast< double >(val12);
-  (arg1)->_predict_gp(arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12);
+  ecode13 = SWIG_AsVal_size_t(swig_obj[7], &val13);
+  if (!SWIG_IsOK(ecode13)) {
+    SWIG_exception_fail(SWIG_ArgError(ecode13), "in method '" "XBARTcpp__predict_gp" "', argument " "13"" of type '" "size_t""'");
+  } 
+  arg13 = static_cast< size_t >(val13);
+  {
+    try {
+      (arg1)->_predict_gp(arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12,arg13);
+    } catch (const std::invalid_argument &e) {
+      SWIG_exception_fail(SWIG_ValueError, e.what());
+    }
+  }
   resultobj = SWIG_Py_Void();
   {
     if (is_new_object2 && array2)
@@ -7293,6 +7384,7 @@ static PyMethodDef SwigMethods[] = {
 	 { "new_XBARTcpp", _wrap_new_XBARTcpp, METH_VARARGS, NULL},
 	 { "XBARTcpp__fit", _wrap_XBARTcpp__fit, METH_VARARGS, NULL},
 	 { "XBARTcpp__predict", _wrap_XBARTcpp__predict, METH_VARARGS, NULL},
+	 { "XBARTcpp__predict_one", _wrap_XBARTcpp__predict_one, METH_VARARGS, NULL},
 	 { "XBARTcpp__predict_gp", _wrap_XBARTcpp__predict_gp, METH_VARARGS, NULL},
 	 { "XBARTcpp_np_to_vec_d", _wrap_XBARTcpp_np_to_vec_d, METH_VARARGS, NULL},
 	 { "XBARTcpp_np_to_col_major_vec", _wrap_XBARTcpp_np_to_col_major_vec, METH_VARARGS, NULL},
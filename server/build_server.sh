@@ -0,0 +1,10 @@
+#! /bin/bash
+# build the standalone scoring server, requires armadillo and gsl (same as the R package)
+CXX=${CXX:-g++}
+SRC=../src
+
+$CXX -std=c++17 -O3 -pthread -I$SRC -o xbart_server xbart_server.cpp \
+    $SRC/compiled_forest.cpp $SRC/json_io.cpp $SRC/tree.cpp $SRC/model.cpp \
+    $SRC/model_XBCF_continuous.cpp $SRC/model_XBCF_discrete.cpp $SRC/model_hsknorm.cpp $SRC/model_lognorm.cpp \
+    $SRC/utility.cpp $SRC/common.cpp $SRC/cdf.cpp $SRC/sample_int_crank.cpp $SRC/thread_pool.cpp \
+    -larmadillo -lgsl
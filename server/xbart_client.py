@@ -0,0 +1,48 @@
+# minimal client for xbart_server, see the protocol description in xbart_server.cpp
+#
+# python xbart_client.py /tmp/xbart.sock
+import socket
+import struct
+import sys
+
+REQUEST_MAGIC = 0x58425352
+OP_MEAN, OP_DRAWS, OP_STATS = 0, 1, 2
+
+
+def _recv_all(sock, size):
+	buffer = b""
+	while len(buffer) < size:
+		chunk = sock.recv(size - len(buffer))
+		if not chunk:
+			raise ConnectionError("connection closed by server")
+		buffer += chunk
+	return buffer
+
+
+def request(sock, op, x = [], model = 0):
+	'''
+	Send one request and return the response as a list of rows
+	x : list of rows, each row is a list of floats, one per column of the training data
+	'''
+	n_rows = len(x)
+	p = len(x[0]) if n_rows > 0 else 0
+	values = [v for row in x for v in row]
+	sock.sendall(struct.pack("=5I", REQUEST_MAGIC, op, model, n_rows, p) + struct.pack("=%dd" % len(values), *values))
+	status, n_rows, n_cols = struct.unpack("=3I", _recv_all(sock, 12))
+	if status != 0:
+		raise ValueError("bad request")
+	values = struct.unpack("=%dd" % (n_rows * n_cols), _recv_all(sock, 8 * n_rows * n_cols))
+	return [list(values[i * n_cols:(i + 1) * n_cols]) for i in range(n_rows)]
+
+
+if __name__ == "__main__":
+	sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+	sock.connect(sys.argv[1] if len(sys.argv) > 1 else "/tmp/xbart.sock")
+
+	x = [[0.1 * i - 0.2 * j for j in range(4)] for i in range(5)]
+	print(request(sock, OP_MEAN, x))
+	print(len(request(sock, OP_DRAWS, x)[0]))
+	for upper, count in request(sock, OP_STATS):
+		if count > 0:
+			print("< %d us: %d" % (upper, count))
+	sock.close()
@@ -0,0 +1,592 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// standalone scoring server for fitted XBART forests
+//
+// usage:
+//   xbart_server --model forest.json [--model forest2.json] [--socket /tmp/xbart.sock]
+//                [--threads 4] [--burnin 0] [--max-rows 65536] [--timeout 10]
+//   xbart_server --model forest.json --convert forest.bin
+//
+// models are forests exported by get_forest_json (tree_json of the R / python objects)
+// or the binary format written by --convert. XBCF models are served as two forests
+// (tree_json_con and tree_json_mod), the client combines them.
+//
+// protocol over a unix domain socket, all integers uint32 and all values double, native byte order
+//   request  : magic, op, model, n_rows, p, then n_rows * p values (row major)
+//   response : status, n_rows, n_cols, then n_rows * n_cols values (row major)
+//   op 0 : posterior mean of each row, average of sweeps after the burnin of each chain, n_cols = 1
+//   op 1 : prediction of each sweep, n_cols = num_sweeps
+//   op 2 : latency histogram, one row per bucket (upper bound in microseconds, count), n_cols = 2
+// p must equal the number of columns of the training data (printed at startup), models saved without it accept
+// any p of at least the largest split variable + 1, n_rows must not exceed --max-rows,
+// otherwise status is 1 and the connection is closed
+// status 2 means the server could not allocate the request, the connection is closed as well
+// a connection can send any number of requests, it is closed by the client
+// idle connections wait in poll without holding a worker, a request has to arrive within --timeout seconds once started
+//////////////////////////////////////////////////////////////////////////////////////
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "compiled_forest.h"
+#include "json_io.h"
+
+static const uint32_t request_magic = 0x58425352; // "XBSR"
+static const size_t num_buckets = 32;
+
+enum request_op
+{
+    op_mean = 0,
+    op_draws = 1,
+    op_stats = 2
+};
+
+enum response_status
+{
+    status_ok = 0,
+    status_bad_request = 1,
+    status_server_error = 2
+};
+
+struct server_options
+{
+    std::vector<std::string> model_files;
+    std::string socket_path = "/tmp/xbart.sock";
+    std::string convert_file;
+    size_t nthread = 4;
+    size_t burnin = 0;
+    size_t max_rows = 65536; // largest request accepted, bounds the buffers allocated for a client
+    size_t timeout = 10;     // seconds a started request may stall before the connection is dropped
+};
+
+// buffers of one worker, reused across requests
+struct request_buffers
+{
+    std::vector<double> rows;
+    std::vector<double> yhat;
+    std::vector<double> output;
+};
+
+// latency histogram, bucket i counts requests taking less than 2^i microseconds
+struct latency_histogram
+{
+    std::atomic<uint64_t> counts[num_buckets];
+
+    latency_histogram()
+    {
+        for (size_t i = 0; i < num_buckets; i++)
+        {
+            counts[i] = 0;
+        }
+    }
+
+    void add(double microseconds)
+    {
+        size_t bucket = 0;
+        while (bucket + 1 < num_buckets && microseconds >= (double)(1ULL << bucket))
+        {
+            bucket++;
+        }
+        counts[bucket]++;
+    }
+
+    void print(std::ostream &out) const
+    {
+        out << "latency (us)   count" << endl;
+        for (size_t i = 0; i < num_buckets; i++)
+        {
+            if (counts[i] > 0)
+            {
+                out << "< " << (1ULL << i) << "\t" << counts[i] << endl;
+            }
+        }
+    }
+};
+
+static std::vector<compiled_forest> forests;
+static std::vector<std::vector<size_t>> kept_sweeps; // sweeps averaged by op 0, one list per model
+static latency_histogram histogram;
+static server_options options;
+static std::atomic<bool> stopping(false);
+static int listen_fd = -1;
+static int wake_pipe[2] = {-1, -1}; // wakes the dispatcher when a connection is returned or the server stops
+
+// connections being served, shut down when the server stops
+static std::set<int> active_connections;
+static std::mutex active_mutex;
+
+static bool read_all(int fd, void *buffer, size_t size)
+{
+    char *p = static_cast<char *>(buffer);
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void *buffer, size_t size)
+{
+    const char *p = static_cast<const char *>(buffer);
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool send_response(int fd, uint32_t status, uint32_t n_rows, uint32_t n_cols, const std::vector<double> &values)
+{
+    uint32_t header[3] = {status, n_rows, n_cols};
+    return write_all(fd, header, sizeof(header)) && write_all(fd, values.data(), (size_t)n_rows * n_cols * sizeof(double));
+}
+
+// read and answer one request, returns false if the connection should be closed
+static bool serve_request(int fd, request_buffers &buffers)
+{
+    std::vector<double> &rows = buffers.rows;
+    std::vector<double> &yhat = buffers.yhat;
+    std::vector<double> &output = buffers.output;
+    uint32_t header[5];
+
+    if (!read_all(fd, header, sizeof(header)))
+    {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t magic = header[0], op = header[1], model = header[2], n_rows = header[3], p = header[4];
+    if (magic != request_magic || op > op_stats || model >= forests.size())
+    {
+        // cannot resynchronize the stream, drop the connection
+        output.clear();
+        send_response(fd, status_bad_request, 0, 0, output);
+        return false;
+    }
+
+    if (op == op_stats)
+    {
+        output.resize(num_buckets * 2);
+        for (size_t i = 0; i < num_buckets; i++)
+        {
+            output[2 * i] = (double)(1ULL << i);
+            output[2 * i + 1] = (double)histogram.counts[i];
+        }
+        return send_response(fd, status_ok, num_buckets, 2, output);
+    }
+
+    // check the size before allocating, the values of a rejected request are not read so the connection is dropped
+    const compiled_forest &forest = forests[model];
+    if ((forest.p_train > 0 ? p != forest.p_train : p < forest.p) || n_rows > options.max_rows)
+    {
+        output.clear();
+        send_response(fd, status_bad_request, 0, 0, output);
+        return false;
+    }
+
+    rows.resize((size_t)n_rows * p);
+    if (!read_all(fd, rows.data(), rows.size() * sizeof(double)))
+    {
+        return false;
+    }
+
+    size_t num_sweeps = forest.num_sweeps;
+    const std::vector<size_t> &kept = kept_sweeps[model];
+    uint32_t n_cols = op == op_mean ? 1 : num_sweeps;
+    yhat.resize(num_sweeps);
+    output.resize((size_t)n_rows * n_cols);
+
+    for (size_t i = 0; i < n_rows; i++)
+    {
+        forest.predict_one(rows.data() + i * p, &yhat[0]);
+        if (op == op_mean)
+        {
+            double sum = 0.0;
+            for (size_t j : kept)
+            {
+                sum += yhat[j];
+            }
+            output[i] = sum / (double)kept.size();
+        }
+        else
+        {
+            std::copy(yhat.begin(), yhat.end(), output.begin() + i * num_sweeps);
+        }
+    }
+
+    bool sent = send_response(fd, status_ok, n_rows, n_cols, output);
+    histogram.add(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    return sent;
+}
+
+static bool serve_connection(int fd, request_buffers &buffers)
+{
+    {
+        std::unique_lock<std::mutex> lock(active_mutex);
+        active_connections.insert(fd);
+    }
+
+    bool keep;
+    try
+    {
+        keep = serve_request(fd, buffers);
+    }
+    catch (const std::exception &)
+    {
+        // allocation failure, the client is told and dropped, the server keeps running
+        std::vector<double> empty;
+        send_response(fd, status_server_error, 0, 0, empty);
+        keep = false;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(active_mutex);
+        active_connections.erase(fd);
+    }
+    return keep;
+}
+
+// drop the first burnin sweeps of every chain, a chain keeps at least its last sweep
+static std::vector<size_t> chain_sweeps_after_burnin(const compiled_forest &forest, size_t burnin)
+{
+    std::vector<size_t> kept;
+    size_t begin = 0;
+    while (begin < forest.num_sweeps)
+    {
+        size_t end = begin;
+        while (end < forest.num_sweeps && forest.chain[end] == forest.chain[begin])
+        {
+            end++;
+        }
+        for (size_t j = begin + std::min(burnin, end - begin - 1); j < end; j++)
+        {
+            kept.push_back(j);
+        }
+        begin = end;
+    }
+    return kept;
+}
+
+static bool load_model(const std::string &file, compiled_forest &forest)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+
+    // binary model first, fall back to json
+    if (forest.load(in))
+    {
+        return true;
+    }
+
+    in.clear();
+    in.seekg(0);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string json_string = buffer.str();
+
+    vector<vector<tree>> trees;
+    double y_mean;
+    std::vector<size_t> chain;
+    size_t p_train;
+    try
+    {
+        from_json_to_forest(json_string, trees, y_mean, chain, p_train);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    if (trees.size() == 0 || trees[0].size() == 0)
+    {
+        return false;
+    }
+    forest.compile(trees);
+    if (p_train > 0 && p_train < forest.p)
+    {
+        return false;
+    }
+    forest.chain = chain;
+    forest.p_train = p_train;
+    return true;
+}
+
+static void handle_signal(int)
+{
+    stopping = true;
+    if (wake_pipe[1] >= 0)
+    {
+        char byte = 0;
+        ssize_t ignored = write(wake_pipe[1], &byte, 1);
+        (void)ignored;
+    }
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        if (arg == "--model")
+        {
+            options.model_files.push_back(argv[++i]);
+        }
+        else if (arg == "--socket")
+        {
+            options.socket_path = argv[++i];
+        }
+        else if (arg == "--threads")
+        {
+            options.nthread = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--burnin")
+        {
+            options.burnin = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--max-rows")
+        {
+            options.max_rows = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--timeout")
+        {
+            options.timeout = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--convert")
+        {
+            options.convert_file = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.model_files.size() > 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (!parse_options(argc, argv))
+    {
+        COUT << "usage: " << argv[0] << " --model file [--model file ...] [--socket path] [--threads n] [--burnin n] [--max-rows n] [--timeout seconds] [--convert file]" << endl;
+        return 1;
+    }
+
+    forests.resize(options.model_files.size());
+    kept_sweeps.resize(options.model_files.size());
+    for (size_t i = 0; i < options.model_files.size(); i++)
+    {
+        if (!load_model(options.model_files[i], forests[i]))
+        {
+            COUT << "cannot load model " << options.model_files[i] << endl;
+            return 1;
+        }
+        kept_sweeps[i] = chain_sweeps_after_burnin(forests[i], options.burnin);
+        COUT << "model " << i << ": " << options.model_files[i] << ", " << forests[i].num_sweeps << " sweeps, " << forests[i].chain.back() + 1 << " chains, " << forests[i].num_trees << " trees, " << forests[i].num_nodes() << " nodes, ";
+        if (forests[i].p_train > 0)
+        {
+            COUT << forests[i].p_train << " columns" << endl;
+        }
+        else
+        {
+            COUT << "at least " << forests[i].p << " columns" << endl;
+        }
+    }
+
+    if (options.convert_file.size() > 0)
+    {
+        std::ofstream out(options.convert_file, std::ios::binary);
+        forests[0].save(out);
+        return out ? 0 : 1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(options.socket_path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(listen_fd, 64) < 0)
+    {
+        COUT << "cannot listen on " << options.socket_path << endl;
+        return 1;
+    }
+
+    if (pipe(wake_pipe) < 0)
+    {
+        COUT << "cannot create pipe" << endl;
+        return 1;
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    // the dispatcher (this thread) polls idle connections, a connection with a pending request is queued and
+    // served by the first free worker, which hands it back to the dispatcher after one request
+    std::vector<int> idle;      // owned by the dispatcher
+    std::deque<int> ready;      // pending requests, guarded by ready_mutex
+    std::vector<int> returned;  // handed back by workers, guarded by ready_mutex
+    std::mutex ready_mutex;
+    std::condition_variable ready_changed;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < options.nthread; i++)
+    {
+        workers.emplace_back([&]()
+                             {
+                                 request_buffers buffers;
+                                 while (true)
+                                 {
+                                     std::unique_lock<std::mutex> lock(ready_mutex);
+                                     ready_changed.wait(lock, [&]() { return stopping || !ready.empty(); });
+                                     if (stopping)
+                                     {
+                                         return;
+                                     }
+                                     int fd = ready.front();
+                                     ready.pop_front();
+                                     lock.unlock();
+
+                                     if (!serve_connection(fd, buffers))
+                                     {
+                                         close(fd);
+                                         continue;
+                                     }
+                                     lock.lock();
+                                     returned.push_back(fd);
+                                     lock.unlock();
+                                     char byte = 0;
+                                     ssize_t ignored = write(wake_pipe[1], &byte, 1);
+                                     (void)ignored;
+                                 } });
+    }
+
+    COUT << "listening on " << options.socket_path << " with " << options.nthread << " workers" << endl;
+
+    timeval timeout;
+    timeout.tv_sec = options.timeout;
+    timeout.tv_usec = 0;
+    std::vector<pollfd> poll_fds;
+    while (!stopping)
+    {
+        poll_fds.clear();
+        poll_fds.push_back({listen_fd, POLLIN, 0});
+        poll_fds.push_back({wake_pipe[0], POLLIN, 0});
+        for (size_t i = 0; i < idle.size(); i++)
+        {
+            poll_fds.push_back({idle[i], POLLIN, 0});
+        }
+        if (poll(poll_fds.data(), poll_fds.size(), -1) < 0)
+        {
+            continue;
+        }
+
+        // connections with data, or closed by the client, go to the workers
+        size_t kept = 0;
+        {
+            std::unique_lock<std::mutex> lock(ready_mutex);
+            for (size_t i = 0; i < idle.size(); i++)
+            {
+                if (poll_fds[i + 2].revents)
+                {
+                    ready.push_back(idle[i]);
+                    ready_changed.notify_one();
+                }
+                else
+                {
+                    idle[kept++] = idle[i];
+                }
+            }
+            idle.resize(kept);
+        }
+
+        if (poll_fds[1].revents)
+        {
+            char bytes[64];
+            while (read(wake_pipe[0], bytes, sizeof(bytes)) > 0)
+            {
+            }
+            std::unique_lock<std::mutex> lock(ready_mutex);
+            idle.insert(idle.end(), returned.begin(), returned.end());
+            returned.clear();
+        }
+
+        if (poll_fds[0].revents)
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0)
+            {
+                // a stalled request fails the read after timeout instead of holding its worker
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                idle.push_back(fd);
+            }
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(ready_mutex);
+        ready_changed.notify_all();
+    }
+    {
+        std::unique_lock<std::mutex> lock(active_mutex);
+        for (auto fd : active_connections)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    for (size_t i = 0; i < idle.size(); i++)
+    {
+        close(idle[i]);
+    }
+    for (size_t i = 0; i < ready.size(); i++)
+    {
+        close(ready[i]);
+    }
+    for (size_t i = 0; i < returned.size(); i++)
+    {
+        close(returned[i]);
+    }
+    close(listen_fd);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    unlink(options.socket_path.c_str());
+
+    histogram.print(COUT);
+    return 0;
+}
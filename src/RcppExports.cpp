@@ -8,8 +8,8 @@
 using namespace Rcpp;
 
 // XBART_cpp
-Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau, double no_split_penalty, size_t burnin, size_t mtry, size_t p_categorical, double kap, double s, double tau_kap, double tau_s, bool verbose, bool sampling_tau, bool parallel, bool set_random_seed, size_t random_seed, bool sample_weights, double nthread);
-RcppExport SEXP _XBART_XBART_cpp(SEXP ySEXP, SEXP XSEXP, SEXP num_treesSEXP, SEXP num_sweepsSEXP, SEXP max_depthSEXP, SEXP n_minSEXP, SEXP num_cutpointsSEXP, SEXP alphaSEXP, SEXP betaSEXP, SEXP tauSEXP, SEXP no_split_penaltySEXP, SEXP burninSEXP, SEXP mtrySEXP, SEXP p_categoricalSEXP, SEXP kapSEXP, SEXP sSEXP, SEXP tau_kapSEXP, SEXP tau_sSEXP, SEXP verboseSEXP, SEXP sampling_tauSEXP, SEXP parallelSEXP, SEXP set_random_seedSEXP, SEXP random_seedSEXP, SEXP sample_weightsSEXP, SEXP nthreadSEXP) {
+Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau, double no_split_penalty, size_t burnin, size_t mtry, size_t p_categorical, double kap, double s, double tau_kap, double tau_s, bool verbose, bool sampling_tau, bool parallel, bool set_random_seed, size_t random_seed, bool sample_weights, double nthread, size_t num_chains, double subsample, std::string warm_start, mat Xorder_append, bool keep_xorder, double stop_tol, size_t stop_patience);
+RcppExport SEXP _XBART_XBART_cpp(SEXP ySEXP, SEXP XSEXP, SEXP num_treesSEXP, SEXP num_sweepsSEXP, SEXP max_depthSEXP, SEXP n_minSEXP, SEXP num_cutpointsSEXP, SEXP alphaSEXP, SEXP betaSEXP, SEXP tauSEXP, SEXP no_split_penaltySEXP, SEXP burninSEXP, SEXP mtrySEXP, SEXP p_categoricalSEXP, SEXP kapSEXP, SEXP sSEXP, SEXP tau_kapSEXP, SEXP tau_sSEXP, SEXP verboseSEXP, SEXP sampling_tauSEXP, SEXP parallelSEXP, SEXP set_random_seedSEXP, SEXP random_seedSEXP, SEXP sample_weightsSEXP, SEXP nthreadSEXP, SEXP num_chainsSEXP, SEXP subsampleSEXP, SEXP warm_startSEXP, SEXP Xorder_appendSEXP, SEXP keep_xorderSEXP, SEXP stop_tolSEXP, SEXP stop_patienceSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -38,7 +38,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< size_t >::type random_seed(random_seedSEXP);
     Rcpp::traits::input_parameter< bool >::type sample_weights(sample_weightsSEXP);
     Rcpp::traits::input_parameter< double >::type nthread(nthreadSEXP);
-    rcpp_result_gen = Rcpp::wrap(XBART_cpp(y, X, num_trees, num_sweeps, max_depth, n_min, num_cutpoints, alpha, beta, tau, no_split_penalty, burnin, mtry, p_categorical, kap, s, tau_kap, tau_s, verbose, sampling_tau, parallel, set_random_seed, random_seed, sample_weights, nthread));
+    Rcpp::traits::input_parameter< size_t >::type num_chains(num_chainsSEXP);
+    Rcpp::traits::input_parameter< double >::type subsample(subsampleSEXP);
+    Rcpp::traits::input_parameter< std::string >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< mat >::type Xorder_append(Xorder_appendSEXP);
+    Rcpp::traits::input_parameter< bool >::type keep_xorder(keep_xorderSEXP);
+    Rcpp::traits::input_parameter< double >::type stop_tol(stop_tolSEXP);
+    Rcpp::traits::input_parameter< size_t >::type stop_patience(stop_patienceSEXP);
+    rcpp_result_gen = Rcpp::wrap(XBART_cpp(y, X, num_trees, num_sweeps, max_depth, n_min, num_cutpoints, alpha, beta, tau, no_split_penalty, burnin, mtry, p_categorical, kap, s, tau_kap, tau_s, verbose, sampling_tau, parallel, set_random_seed, random_seed, sample_weights, nthread, num_chains, subsample, warm_start, Xorder_append, keep_xorder, stop_tol, stop_patience));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -86,8 +93,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // XBART_multinomial_cpp
-Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau_a, double tau_b, double no_split_penalty, size_t burnin, size_t mtry, size_t p_categorical, bool verbose, bool parallel, bool set_random_seed, size_t random_seed, bool sample_weights, bool separate_tree, double weight, bool update_weight, bool update_tau, bool update_phi, double nthread, double hmult, double heps, double a, size_t weight_exponent, double MH_step);
-RcppExport SEXP _XBART_XBART_multinomial_cpp(SEXP ySEXP, SEXP num_classSEXP, SEXP XSEXP, SEXP num_treesSEXP, SEXP num_sweepsSEXP, SEXP max_depthSEXP, SEXP n_minSEXP, SEXP num_cutpointsSEXP, SEXP alphaSEXP, SEXP betaSEXP, SEXP tau_aSEXP, SEXP tau_bSEXP, SEXP no_split_penaltySEXP, SEXP burninSEXP, SEXP mtrySEXP, SEXP p_categoricalSEXP, SEXP verboseSEXP, SEXP parallelSEXP, SEXP set_random_seedSEXP, SEXP random_seedSEXP, SEXP sample_weightsSEXP, SEXP separate_treeSEXP, SEXP weightSEXP, SEXP update_weightSEXP, SEXP update_tauSEXP, SEXP update_phiSEXP, SEXP nthreadSEXP, SEXP hmultSEXP, SEXP hepsSEXP, SEXP aSEXP, SEXP weight_exponentSEXP, SEXP MH_stepSEXP) {
+Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau_a, double tau_b, double no_split_penalty, size_t burnin, size_t mtry, size_t p_categorical, bool verbose, bool parallel, bool set_random_seed, size_t random_seed, bool sample_weights, bool separate_tree, double weight, bool update_weight, bool update_tau, bool update_phi, double nthread, double hmult, double heps, double a, size_t weight_exponent, double MH_step, double stop_tol, size_t stop_patience);
+RcppExport SEXP _XBART_XBART_multinomial_cpp(SEXP ySEXP, SEXP num_classSEXP, SEXP XSEXP, SEXP num_treesSEXP, SEXP num_sweepsSEXP, SEXP max_depthSEXP, SEXP n_minSEXP, SEXP num_cutpointsSEXP, SEXP alphaSEXP, SEXP betaSEXP, SEXP tau_aSEXP, SEXP tau_bSEXP, SEXP no_split_penaltySEXP, SEXP burninSEXP, SEXP mtrySEXP, SEXP p_categoricalSEXP, SEXP verboseSEXP, SEXP parallelSEXP, SEXP set_random_seedSEXP, SEXP random_seedSEXP, SEXP sample_weightsSEXP, SEXP separate_treeSEXP, SEXP weightSEXP, SEXP update_weightSEXP, SEXP update_tauSEXP, SEXP update_phiSEXP, SEXP nthreadSEXP, SEXP hmultSEXP, SEXP hepsSEXP, SEXP aSEXP, SEXP weight_exponentSEXP, SEXP MH_stepSEXP, SEXP stop_tolSEXP, SEXP stop_patienceSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -123,7 +130,37 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type a(aSEXP);
     Rcpp::traits::input_parameter< size_t >::type weight_exponent(weight_exponentSEXP);
     Rcpp::traits::input_parameter< double >::type MH_step(MH_stepSEXP);
-    rcpp_result_gen = Rcpp::wrap(XBART_multinomial_cpp(y, num_class, X, num_trees, num_sweeps, max_depth, n_min, num_cutpoints, alpha, beta, tau_a, tau_b, no_split_penalty, burnin, mtry, p_categorical, verbose, parallel, set_random_seed, random_seed, sample_weights, separate_tree, weight, update_weight, update_tau, update_phi, nthread, hmult, heps, a, weight_exponent, MH_step));
+    Rcpp::traits::input_parameter< double >::type stop_tol(stop_tolSEXP);
+    Rcpp::traits::input_parameter< size_t >::type stop_patience(stop_patienceSEXP);
+    rcpp_result_gen = Rcpp::wrap(XBART_multinomial_cpp(y, num_class, X, num_trees, num_sweeps, max_depth, n_min, num_cutpoints, alpha, beta, tau_a, tau_b, no_split_penalty, burnin, mtry, p_categorical, verbose, parallel, set_random_seed, random_seed, sample_weights, separate_tree, weight, update_weight, update_tau, update_phi, nthread, hmult, heps, a, weight_exponent, MH_step, stop_tol, stop_patience));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rgig_cpp
+Rcpp::NumericVector rgig_cpp(size_t n, double lambda, double chi, double psi, size_t random_seed);
+RcppExport SEXP _XBART_rgig_cpp(SEXP nSEXP, SEXP lambdaSEXP, SEXP chiSEXP, SEXP psiSEXP, SEXP random_seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< size_t >::type n(nSEXP);
+    Rcpp::traits::input_parameter< double >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< double >::type chi(chiSEXP);
+    Rcpp::traits::input_parameter< double >::type psi(psiSEXP);
+    Rcpp::traits::input_parameter< size_t >::type random_seed(random_seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(rgig_cpp(n, lambda, chi, psi, random_seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// log_bessel_k_cpp
+Rcpp::NumericVector log_bessel_k_cpp(Rcpp::NumericVector nu, Rcpp::NumericVector x, double order);
+RcppExport SEXP _XBART_log_bessel_k_cpp(SEXP nuSEXP, SEXP xSEXP, SEXP orderSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type nu(nuSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< double >::type order(orderSEXP);
+    rcpp_result_gen = Rcpp::wrap(log_bessel_k_cpp(nu, x, order));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -277,9 +314,52 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// xbart_predict_summary
+Rcpp::List xbart_predict_summary(mat X, double y_mean, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt, Rcpp::IntegerVector sweeps, std::vector<double> quantiles);
+RcppExport SEXP _XBART_xbart_predict_summary(SEXP XSEXP, SEXP y_meanSEXP, SEXP tree_pntSEXP, SEXP sweepsSEXP, SEXP quantilesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< mat >::type X(XSEXP);
+    Rcpp::traits::input_parameter< double >::type y_mean(y_meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::XPtr<std::vector<std::vector<tree>>> >::type tree_pnt(tree_pntSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type sweeps(sweepsSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type quantiles(quantilesSEXP);
+    rcpp_result_gen = Rcpp::wrap(xbart_predict_summary(X, y_mean, tree_pnt, sweeps, quantiles));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xbart_predict_leaf
+Rcpp::List xbart_predict_leaf(mat X, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt);
+RcppExport SEXP _XBART_xbart_predict_leaf(SEXP XSEXP, SEXP tree_pntSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< mat >::type X(XSEXP);
+    Rcpp::traits::input_parameter< Rcpp::XPtr<std::vector<std::vector<tree>>> >::type tree_pnt(tree_pntSEXP);
+    rcpp_result_gen = Rcpp::wrap(xbart_predict_leaf(X, tree_pnt));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xbart_predict_from_leaf
+Rcpp::List xbart_predict_from_leaf(Rcpp::IntegerVector leaf_index, Rcpp::NumericVector leaf_values, size_t N, size_t N_sweeps, size_t M, size_t max_leaves);
+RcppExport SEXP _XBART_xbart_predict_from_leaf(SEXP leaf_indexSEXP, SEXP leaf_valuesSEXP, SEXP NSEXP, SEXP N_sweepsSEXP, SEXP MSEXP, SEXP max_leavesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type leaf_index(leaf_indexSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type leaf_values(leaf_valuesSEXP);
+    Rcpp::traits::input_parameter< size_t >::type N(NSEXP);
+    Rcpp::traits::input_parameter< size_t >::type N_sweeps(N_sweepsSEXP);
+    Rcpp::traits::input_parameter< size_t >::type M(MSEXP);
+    Rcpp::traits::input_parameter< size_t >::type max_leaves(max_leavesSEXP);
+    rcpp_result_gen = Rcpp::wrap(xbart_predict_from_leaf(leaf_index, leaf_values, N, N_sweeps, M, max_leaves));
+    return rcpp_result_gen;
+END_RCPP
+}
 // gp_predict
-Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt, Rcpp::NumericVector resid, mat sigma, double theta, double tau, size_t p_categorical);
-RcppExport SEXP _XBART_gp_predict(SEXP ySEXP, SEXP XSEXP, SEXP XtestSEXP, SEXP tree_pntSEXP, SEXP residSEXP, SEXP sigmaSEXP, SEXP thetaSEXP, SEXP tauSEXP, SEXP p_categoricalSEXP) {
+Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt, Rcpp::NumericVector resid, mat sigma, double theta, double tau, size_t p_categorical, size_t max_train, bool parallel, double nthread);
+RcppExport SEXP _XBART_gp_predict(SEXP ySEXP, SEXP XSEXP, SEXP XtestSEXP, SEXP tree_pntSEXP, SEXP residSEXP, SEXP sigmaSEXP, SEXP thetaSEXP, SEXP tauSEXP, SEXP p_categoricalSEXP, SEXP max_trainSEXP, SEXP parallelSEXP, SEXP nthreadSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -292,7 +372,10 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type theta(thetaSEXP);
     Rcpp::traits::input_parameter< double >::type tau(tauSEXP);
     Rcpp::traits::input_parameter< size_t >::type p_categorical(p_categoricalSEXP);
-    rcpp_result_gen = Rcpp::wrap(gp_predict(y, X, Xtest, tree_pnt, resid, sigma, theta, tau, p_categorical));
+    Rcpp::traits::input_parameter< size_t >::type max_train(max_trainSEXP);
+    Rcpp::traits::input_parameter< bool >::type parallel(parallelSEXP);
+    Rcpp::traits::input_parameter< double >::type nthread(nthreadSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_predict(y, X, Xtest, tree_pnt, resid, sigma, theta, tau, p_categorical, max_train, parallel, nthread));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -384,16 +467,21 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_XBART_XBART_cpp", (DL_FUNC) &_XBART_XBART_cpp, 25},
+    {"_XBART_XBART_cpp", (DL_FUNC) &_XBART_XBART_cpp, 32},
     {"_XBART_XBART_heterosk_cpp", (DL_FUNC) &_XBART_XBART_heterosk_cpp, 33},
-    {"_XBART_XBART_multinomial_cpp", (DL_FUNC) &_XBART_XBART_multinomial_cpp, 32},
+    {"_XBART_XBART_multinomial_cpp", (DL_FUNC) &_XBART_XBART_multinomial_cpp, 34},
+    {"_XBART_rgig_cpp", (DL_FUNC) &_XBART_rgig_cpp, 5},
+    {"_XBART_log_bessel_k_cpp", (DL_FUNC) &_XBART_log_bessel_k_cpp, 3},
     {"_XBART_XBCF_continuous_cpp", (DL_FUNC) &_XBART_XBCF_continuous_cpp, 35},
     {"_XBART_XBCF_discrete_cpp", (DL_FUNC) &_XBART_XBCF_discrete_cpp, 39},
     {"_XBART_xbart_predict", (DL_FUNC) &_XBART_xbart_predict, 3},
     {"_XBART_XBCF_continuous_predict", (DL_FUNC) &_XBART_XBCF_continuous_predict, 5},
     {"_XBART_XBCF_discrete_predict", (DL_FUNC) &_XBART_XBCF_discrete_predict, 5},
     {"_XBART_xbart_predict_full", (DL_FUNC) &_XBART_xbart_predict_full, 3},
-    {"_XBART_gp_predict", (DL_FUNC) &_XBART_gp_predict, 9},
+    {"_XBART_xbart_predict_summary", (DL_FUNC) &_XBART_xbart_predict_summary, 5},
+    {"_XBART_xbart_predict_leaf", (DL_FUNC) &_XBART_xbart_predict_leaf, 2},
+    {"_XBART_xbart_predict_from_leaf", (DL_FUNC) &_XBART_xbart_predict_from_leaf, 6},
+    {"_XBART_gp_predict", (DL_FUNC) &_XBART_gp_predict, 12},
     {"_XBART_xbart_multinomial_predict", (DL_FUNC) &_XBART_xbart_multinomial_predict, 4},
     {"_XBART_xbart_multinomial_predict_separatetrees", (DL_FUNC) &_XBART_xbart_multinomial_predict_separatetrees, 4},
     {"_XBART_r_to_json", (DL_FUNC) &_XBART_r_to_json, 2},
@@ -8,6 +8,7 @@
 #include "X_struct.h"
 #include "utility_rcpp.h"
 #include "json_io.h"
+#include "compiled_forest.h"
 
 using namespace std;
 using namespace chrono;
@@ -15,13 +16,8 @@ using namespace arma;
 
 // [[Rcpp::plugins(cpp11)]]
 // [[Rcpp::export]]
-Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau, double no_split_penalty, size_t burnin = 1, size_t mtry = 0, size_t p_categorical = 0, double kap = 16, double s = 4, double tau_kap = 3, double tau_s = 0.5, bool verbose = false, bool sampling_tau = true, bool parallel = true, bool set_random_seed = false, size_t random_seed = 0, bool sample_weights = true, double nthread = 0)
+Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau, double no_split_penalty, size_t burnin = 1, size_t mtry = 0, size_t p_categorical = 0, double kap = 16, double s = 4, double tau_kap = 3, double tau_s = 0.5, bool verbose = false, bool sampling_tau = true, bool parallel = true, bool set_random_seed = false, size_t random_seed = 0, bool sample_weights = true, double nthread = 0, size_t num_chains = 1, double subsample = 1.0, std::string warm_start = "", mat Xorder_append = mat(), bool keep_xorder = false, double stop_tol = 0.0, size_t stop_patience = 3)
 {
-    if (parallel)
-    {
-        thread_pool.start(nthread);
-    }
-    
     size_t N = X.n_rows;
 
     // number of total variables
@@ -55,42 +51,151 @@ Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t m
 
     Rcpp::NumericMatrix X_std(N, p);
 
-    rcpp_to_std2(y, X, y_std, y_mean, X_std, Xorder_std);
+    if (Xorder_append.n_rows > 0)
+    {
+        // rows appended to a previous fit, merge them into its sorted order
+        rcpp_to_std2_append(y, X, Xorder_append, y_std, y_mean, X_std, Xorder_std);
+    }
+    else
+    {
+        rcpp_to_std2(y, X, y_std, y_mean, X_std, Xorder_std);
+    }
 
     ///////////////////////////////////////////////////////////////////
 
     // double *ypointer = &y_std[0];
     double *Xpointer = &X_std[0];
 
-    matrix<double> sigma_draw_xinfo;
-    ini_matrix(sigma_draw_xinfo, num_trees, num_sweeps);
-
-    // Create trees
-    vector<vector<tree>> trees(num_sweeps);
-    for (size_t i = 0; i < num_sweeps; i++)
-    {
-        trees[i].resize(num_trees);
-    }
+    // independent chains share data, Xorder_std and the unique value tables of X_struct
+    // each chain has its own state, model, leaf pointers and random number generator
+    // draws of all chains are stacked along the sweeps dimension, chain by chain
 
     // define model
     NormalModel *model = new NormalModel(kap, s, tau, alpha, beta, sampling_tau, tau_kap, tau_s);
 
     model->setNoSplitPenalty(no_split_penalty);
 
-    // State settings
-    std::vector<double> initial_theta(1, y_mean / (double)num_trees);
-    NormalState state(Xpointer, Xorder_std, N, p, num_trees, p_categorical, p_continuous, set_random_seed, random_seed, n_min, num_cutpoints, mtry, Xpointer, num_sweeps, sample_weights, &y_std, 1.0, max_depth, y_mean, burnin, model->dim_residual, nthread, parallel);
-
     // initialize X_struct
+    std::vector<double> initial_theta(1, y_mean / (double)num_trees);
     X_struct x_struct(Xpointer, &y_std, N, Xorder_std, p_categorical, p_continuous, &initial_theta, num_trees);
-    
+
+    // warm start, every chain continues from the last sweep of a saved forest
+    // the saved trees are only read and stay alive until all chains are done
+    vector<vector<tree>> warm_start_trees;
+    if (!warm_start.empty())
+    {
+        double warm_start_y_mean;
+        std::vector<size_t> warm_start_chain;
+        size_t warm_start_p;
+        from_json_to_forest(warm_start, warm_start_trees, warm_start_y_mean, warm_start_chain, warm_start_p);
+        if (warm_start_trees[0].size() != num_trees)
+        {
+            throw std::invalid_argument("number of trees of the warm start forest does not match num_trees");
+        }
+        if (warm_start_p > 0 && warm_start_p != p)
+        {
+            throw std::invalid_argument("the warm start forest was fitted on a different number of columns than X");
+        }
+        if (compiled_forest(warm_start_trees).p > p)
+        {
+            throw std::invalid_argument("the warm start forest splits on more columns than X has");
+        }
+    }
+
+    // start the pool after all checks, an exception above would leave it running for the next call
+    if (parallel)
+    {
+        thread_pool.start(nthread);
+    }
+
+    // chains run concurrently on the thread pool, each chain grows its trees on a single thread
+    bool parallel_chains = parallel && num_chains > 1;
+
+    std::vector<NormalModel> chain_models(num_chains, *model);
+    // chain 0 fits on x_struct, other chains share its unique value tables and get their own leaf pointers
+    std::vector<X_struct> chain_x_structs;
+    chain_x_structs.reserve(num_chains - 1);
+    for (size_t chain = 1; chain < num_chains; chain++)
+    {
+        chain_x_structs.emplace_back(x_struct, &initial_theta, num_trees);
+    }
+    std::vector<NormalState> chain_states;
+    chain_states.reserve(num_chains);
+    for (size_t chain = 0; chain < num_chains; chain++)
+    {
+        chain_states.emplace_back(Xpointer, Xorder_std, N, p, num_trees, p_categorical, p_continuous, set_random_seed, random_seed + chain, n_min, num_cutpoints, mtry, Xpointer, num_sweeps, sample_weights, &y_std, 1.0, max_depth, y_mean, burnin, model->dim_residual, nthread, parallel && !parallel_chains);
+        chain_states[chain].subsample = subsample;
+        chain_states[chain].stop_tol = stop_tol;
+        chain_states[chain].stop_patience = stop_patience;
+    }
+
+    std::vector<matrix<double>> chain_sigma_draw_xinfo(num_chains);
+    std::vector<vector<vector<tree>>> chain_trees(num_chains);
+    std::vector<std::vector<double>> chain_resid(num_chains);
+    for (size_t chain = 0; chain < num_chains; chain++)
+    {
+        ini_matrix(chain_sigma_draw_xinfo[chain], num_trees, num_sweeps);
+        chain_trees[chain].resize(num_sweeps);
+        for (size_t i = 0; i < num_sweeps; i++)
+        {
+            chain_trees[chain][i].resize(num_trees);
+        }
+        chain_resid[chain].resize(N * num_sweeps * num_trees);
+    }
+
     ////////////////////////////////////////////////////////////////
-    std::vector<double> resid(N * num_sweeps * num_trees);
+    auto run_chain = [&](size_t chain)
+    {
+        // console output is not thread safe, only print from the calling thread
+        mcmc_loop(Xorder_std, verbose && !parallel_chains, chain_sigma_draw_xinfo[chain], chain_trees[chain], no_split_penalty, chain_states[chain], &chain_models[chain], chain == 0 ? x_struct : chain_x_structs[chain - 1], chain_resid[chain], warm_start.empty() ? nullptr : &warm_start_trees);
+    };
+
+    for (size_t chain = 0; chain < num_chains; chain++)
+    {
+        if (thread_pool.is_active() && parallel_chains)
+            thread_pool.add_task(run_chain, chain);
+        else
+            run_chain(chain);
+    }
+    if (thread_pool.is_active() && parallel_chains)
+        thread_pool.wait();
+
+    // stack chains, each chain may stop early after a different number of sweeps
+    size_t num_draws = 0;
+    for (size_t chain = 0; chain < num_chains; chain++)
+    {
+        num_draws += chain_states[chain].num_sweeps_run;
+    }
 
-    mcmc_loop(Xorder_std, verbose, sigma_draw_xinfo, trees, no_split_penalty, state, model, x_struct, resid);
+    matrix<double> sigma_draw_xinfo(num_draws);
+    vector<vector<tree>> trees(num_draws);
+    std::vector<double> resid(N * num_draws * num_trees);
+    std::vector<double> split_count_all(p, 0.0);
+    std::vector<size_t> chain_draws(num_draws);
+    size_t nodes_serial = 0, nodes_parallel = 0;
+    size_t draw = 0;
+    for (size_t chain = 0; chain < num_chains; chain++)
+    {
+        for (size_t sweeps = 0; sweeps < chain_states[chain].num_sweeps_run; sweeps++, draw++)
+        {
+            chain_draws[draw] = chain;
+            sigma_draw_xinfo[draw] = chain_sigma_draw_xinfo[chain][sweeps];
+            trees[draw] = std::move(chain_trees[chain][sweeps]);
+            for (size_t tree_ind = 0; tree_ind < num_trees; tree_ind++)
+            {
+                std::copy(chain_resid[chain].begin() + sweeps * N + tree_ind * num_sweeps * N, chain_resid[chain].begin() + (sweeps + 1) * N + tree_ind * num_sweeps * N, resid.begin() + draw * N + tree_ind * num_draws * N);
+            }
+        }
+        for (size_t i = 0; i < p; i++)
+        {
+            split_count_all[i] += (*chain_states[chain].split_count_all)[i];
+        }
+        nodes_serial += chain_states[chain].nodes_serial;
+        nodes_parallel += chain_states[chain].nodes_parallel;
+    }
 
     // R Objects to Return
-    Rcpp::NumericMatrix sigma_draw(num_trees, num_sweeps); // save predictions of each tree
+    Rcpp::NumericMatrix sigma_draw(num_trees, num_draws); // save predictions of each tree
     Rcpp::NumericVector split_count_sum(p, 0);             // split counts
 
     // copy from std vector to Rcpp Numeric Matrix objects
@@ -98,22 +203,50 @@ Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t m
 
     for (size_t i = 0; i < p; i++)
     {
-        split_count_sum(i) = (size_t)(*state.split_count_all)[i];
+        split_count_sum(i) = (size_t)split_count_all[i];
     }
 
     // print out tree structure, for usage of BART warm-start
 
     std::stringstream treess;
 
-    Rcpp::StringVector output_tree(num_sweeps);
-    tree_to_string(trees, output_tree, num_sweeps, num_trees, p);
+    Rcpp::StringVector output_tree(num_draws);
+    tree_to_string(trees, output_tree, num_draws, num_trees, p);
 
     // return the matrix of residuals, useful for prediction by GP
     Rcpp::NumericVector resid_rcpp = Rcpp::wrap(resid);
-    resid_rcpp.attr("dim") = Rcpp::Dimension(N, num_sweeps, num_trees);
+    resid_rcpp.attr("dim") = Rcpp::Dimension(N, num_draws, num_trees);
+
+    // chain index of each stacked sweep and number of sweeps run by each chain
+    Rcpp::IntegerVector chain_index(num_draws);
+    for (size_t i = 0; i < num_draws; i++)
+    {
+        chain_index(i) = chain_draws[i] + 1;
+    }
+    Rcpp::IntegerVector num_sweeps_run(num_chains);
+    for (size_t chain = 0; chain < num_chains; chain++)
+    {
+        num_sweeps_run(chain) = chain_states[chain].num_sweeps_run;
+    }
+
+    // sorted order of each column, used to append rows later
+    // an N by p matrix, only returned on request
+    Rcpp::RObject Xorder_rcpp = R_NilValue;
+    if (keep_xorder)
+    {
+        Rcpp::IntegerMatrix Xorder_mat(N, p);
+        for (size_t j = 0; j < p; j++)
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                Xorder_mat(i, j) = Xorder_std[j][i];
+            }
+        }
+        Xorder_rcpp = Xorder_mat;
+    }
 
     Rcpp::StringVector tree_json(1);
-    json j = get_forest_json(trees, y_mean);
+    json j = get_forest_json(trees, y_mean, chain_draws, p);
     tree_json[0] = j.dump(4);
 
     thread_pool.stop();
@@ -125,5 +258,9 @@ Rcpp::List XBART_cpp(mat y, mat X, size_t num_trees, size_t num_sweeps, size_t m
         Rcpp::Named("model_list") = Rcpp::List::create(Rcpp::Named("y_mean") = y_mean, Rcpp::Named("p") = p),
         Rcpp::Named("treedraws") = output_tree,
         Rcpp::Named("residuals") = resid_rcpp,
-        Rcpp::Named("tree_json") = tree_json);
+        Rcpp::Named("tree_json") = tree_json,
+        Rcpp::Named("chain") = chain_index,
+        Rcpp::Named("num_sweeps_run") = num_sweeps_run,
+        Rcpp::Named("parallel_nodes") = Rcpp::NumericVector::create(Rcpp::Named("serial") = nodes_serial, Rcpp::Named("parallel") = nodes_parallel),
+        Rcpp::Named("Xorder") = Xorder_rcpp);
 }
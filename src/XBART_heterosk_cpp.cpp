@@ -45,6 +45,10 @@ Rcpp::List XBART_heterosk_cpp(arma::mat y,
                               double nthread = 0
                               )
 {
+    if (parallel)
+    {
+        thread_pool.start(nthread);
+    }
 
     size_t N = X.n_rows;
 
@@ -150,6 +154,8 @@ Rcpp::List XBART_heterosk_cpp(arma::mat y,
     tree_json_mean[0] = j.dump(4);
     tree_json_var[0] = j2.dump(4);
 
+    thread_pool.stop();
+
 
     return Rcpp::List::create(
         Rcpp::Named("importance_mean") = split_count_sum_mean,
@@ -14,7 +14,7 @@ using namespace arma;
 
 // [[Rcpp::plugins(cpp11)]]
 // [[Rcpp::export]]
-Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau_a, double tau_b, double no_split_penalty, size_t burnin = 1, size_t mtry = 0, size_t p_categorical = 0, bool verbose = false, bool parallel = true, bool set_random_seed = false, size_t random_seed = 0, bool sample_weights = true, bool separate_tree = false, double weight = 1, bool update_weight = true, bool update_tau = true, bool update_phi = true, double nthread = 0, double hmult = 1, double heps = 0.1, double a = 0.0001, size_t weight_exponent = 4, double MH_step = 0.5)
+Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X, size_t num_trees, size_t num_sweeps, size_t max_depth, size_t n_min, size_t num_cutpoints, double alpha, double beta, double tau_a, double tau_b, double no_split_penalty, size_t burnin = 1, size_t mtry = 0, size_t p_categorical = 0, bool verbose = false, bool parallel = true, bool set_random_seed = false, size_t random_seed = 0, bool sample_weights = true, bool separate_tree = false, double weight = 1, bool update_weight = true, bool update_tau = true, bool update_phi = true, double nthread = 0, double hmult = 1, double heps = 0.1, double a = 0.0001, size_t weight_exponent = 4, double MH_step = 0.5, double stop_tol = 0.0, size_t stop_patience = 3)
 {
     if (parallel)
     {
@@ -83,6 +83,8 @@ Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X,
     std::vector<double> initial_theta(num_class, 1);
     LogitState state(Xpointer, Xorder_std, N, p, num_trees, p_categorical, p_continuous, set_random_seed, random_seed, n_min, num_cutpoints, mtry, Xpointer, num_sweeps, sample_weights, &y_std, 1.0, max_depth, y_mean, burnin, num_class, nthread, a, weight_exponent);
     state.logloss_last_sweep = log(1.0 / num_class);
+    state.stop_tol = stop_tol;
+    state.stop_patience = stop_patience;
 
     // initialize X_struct
     X_struct x_struct(Xpointer, &y_std, N, Xorder_std, p_categorical, p_continuous, &initial_theta, num_trees);
@@ -124,6 +126,11 @@ Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X,
 
         mcmc_loop_multinomial(Xorder_std, verbose, *trees2, no_split_penalty, state, model, x_struct, weight_samples, lambda_samples, phi_samples, logloss, tree_size);
 
+        // keep the sweeps actually run if stopped early
+        num_sweeps = state.num_sweeps_run;
+        trees2->resize(num_sweeps);
+        output_train.resize(num_sweeps * N * num_class);
+
         model->predict_std(Xpointer, N, p, num_trees, num_sweeps, yhats_train_xinfo, *trees2, output_train);
 
         // delete model;
@@ -145,6 +152,14 @@ Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X,
 
         mcmc_loop_multinomial_sample_per_tree(Xorder_std, verbose, *trees3, no_split_penalty, state, model, x_struct, weight_samples, phi_samples, logloss, tree_size);
 
+        // keep the sweeps actually run if stopped early
+        num_sweeps = state.num_sweeps_run;
+        for (size_t i = 0; i < num_class; i++)
+        {
+            (*trees3)[i].resize(num_sweeps);
+        }
+        output_train.resize(num_sweeps * N * num_class);
+
         model->predict_std(Xpointer, N, p, num_trees, num_sweeps, yhats_train_xinfo, *trees3, output_train);
 
         // delete model;
@@ -277,6 +292,7 @@ Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X,
         Rcpp::Named("tree_size") = tree_size_rcpp,
         Rcpp::Named("lambda") = lambda_samples_rcpp,
         Rcpp::Named("importance") = split_count_sum,
+        Rcpp::Named("parallel_nodes") = Rcpp::NumericVector::create(Rcpp::Named("serial") = state.nodes_serial, Rcpp::Named("parallel") = state.nodes_parallel),
         Rcpp::Named("depth") = depth_rcpp,
         Rcpp::Named("treedraws") = output_tree,
         Rcpp::Named("separate_tree") = separate_tree,
@@ -296,3 +312,29 @@ Rcpp::List XBART_multinomial_cpp(Rcpp::IntegerVector y, size_t num_class, mat X,
 
     return ret;
 }
+
+// [[Rcpp::export]]
+Rcpp::NumericVector rgig_cpp(size_t n, double lambda, double chi, double psi, size_t random_seed = 0)
+{
+    // draws from the native generalized inverse Gaussian sampler used by the multinomial model, for testing against GIGrvg::rgig
+    std::mt19937 gen(random_seed);
+    Rcpp::NumericVector output(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        output[i] = rgig(lambda, chi, psi, gen);
+    }
+    return output;
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector log_bessel_k_cpp(Rcpp::NumericVector nu, Rcpp::NumericVector x, double order)
+{
+    // log K_nu(x) from the evaluator used by the multinomial model, orders nu should be order + integer, for testing against GSL
+    log_bessel_k lbk(order);
+    Rcpp::NumericVector output(nu.size());
+    for (R_xlen_t i = 0; i < nu.size(); i++)
+    {
+        output[i] = lbk.evaluate(nu[i], x[i]);
+    }
+    return output;
+}
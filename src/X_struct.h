@@ -2,6 +2,17 @@
 #define GUARD_X_struct_h
 #include "common.h"
 #include "utility.h"
+#include <memory>
+
+// unique values of categorical variables and their counts, computed once from Xorder_std and only read while fitting
+struct X_unique_values
+{
+    std::vector<double> X_values;
+    std::vector<size_t> X_counts;
+    std::vector<size_t> variable_ind;
+    std::vector<size_t> X_num_unique;
+    std::vector<size_t> X_num_cutpoints;
+};
 
 struct X_struct
 {
@@ -12,16 +23,18 @@ public:
     matrix<std::vector<double> *> data_pointers_copy;
     std::vector<std::vector<std::vector<std::vector<double> *>>> data_pointers_multinomial;
 
-    std::vector<double> X_values;
-    std::vector<size_t> X_counts;
-    std::vector<size_t> variable_ind;
-    std::vector<size_t> X_num_unique;
-    std::vector<size_t> X_num_cutpoints;
+    // copies of an X_struct share the unique value tables, the references below point into them
+    std::shared_ptr<X_unique_values> unique_values;
+    std::vector<double> &X_values;
+    std::vector<size_t> &X_counts;
+    std::vector<size_t> &variable_ind;
+    std::vector<size_t> &X_num_unique;
+    std::vector<size_t> &X_num_cutpoints;
     const double *X_std;              // pointer to original data
     const std::vector<double> *y_std; // pointer to y data
     size_t n_y;                       // number of total data points in root node
 
-    X_struct(const double *X_std, const std::vector<double> *y_std, size_t N, std::vector<std::vector<size_t>> &Xorder_std, size_t p_categorical, size_t p_continuous, std::vector<double> *initial_theta, size_t num_trees)
+    X_struct(const double *X_std, const std::vector<double> *y_std, size_t N, std::vector<std::vector<size_t>> &Xorder_std, size_t p_categorical, size_t p_continuous, std::vector<double> *initial_theta, size_t num_trees) : unique_values(std::make_shared<X_unique_values>()), X_values(unique_values->X_values), X_counts(unique_values->X_counts), variable_ind(unique_values->variable_ind), X_num_unique(unique_values->X_num_unique), X_num_cutpoints(unique_values->X_num_cutpoints)
     {
 
         this->variable_ind = std::vector<size_t>(p_categorical + 1);
@@ -40,6 +53,19 @@ public:
         return;
     }
 
+    X_struct(const X_struct &x_struct, std::vector<double> *initial_theta, size_t num_trees) : unique_values(x_struct.unique_values), X_values(unique_values->X_values), X_counts(unique_values->X_counts), variable_ind(unique_values->variable_ind), X_num_unique(unique_values->X_num_unique), X_num_cutpoints(unique_values->X_num_cutpoints)
+    {
+        // same data as x_struct, shares its unique value tables and gets its own leaf pointers
+        // e.g. one per chain, only data_pointers is set up, not the multinomial pointers
+        init_tree_pointers(initial_theta, x_struct.n_y, num_trees);
+
+        this->X_std = x_struct.X_std;
+        this->y_std = x_struct.y_std;
+        this->n_y = x_struct.n_y;
+        this->data_pointers_copy = this->data_pointers;
+        return;
+    }
+
     void create_backup_data_pointers()
     {
         // create a backup copy of data_pointers
@@ -88,30 +114,4 @@ public:
     }
 };
 
-struct gp_struct : public X_struct
-{
-public:
-    std::vector<std::vector<double>> X_range;
-    std::random_device rd;
-    std::mt19937 gen;
-    matrix<std::vector<double>> resid;
-    double num_trees;
-    std::vector<double> sigma;
-
-    gp_struct(const double *X_std, const std::vector<double> *y_std, size_t N, std::vector<std::vector<size_t>> &Xorder_std, size_t p_categorical, size_t p_continuous, std::vector<double> *initial_theta, std::vector<double> sigma, size_t num_trees) : X_struct(X_std, y_std, N, Xorder_std, p_categorical, p_continuous, initial_theta, num_trees)
-    {
-        get_X_range(X_std, Xorder_std, X_range, N);
-
-        this->gen = std::mt19937(rd());
-        this->num_trees = num_trees;
-        this->sigma = sigma;
-        return;
-    }
-
-    void set_resid(matrix<std::vector<double>> &resid)
-    {
-        this->resid = resid;
-    }
-};
-
 #endif
@@ -0,0 +1,287 @@
+#include "compiled_forest.h"
+
+void compiled_forest::compile(std::vector<std::vector<tree>> &trees)
+{
+    num_sweeps = trees.size();
+    num_trees = trees[0].size();
+    chain.assign(num_sweeps, 0);
+    p_train = 0;
+
+    // internal nodes of trees read from json have no leaf parameter, take the dimension from a leaf
+    tree::tree_p leaf = &trees[0][0];
+    while (leaf->getl())
+    {
+        leaf = leaf->getl();
+    }
+    dim_theta = leaf->theta_vector.size();
+
+    size_t total_nodes = 0;
+    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    {
+        for (size_t i = 0; i < num_trees; i++)
+        {
+            total_nodes += trees[sweeps][i].treesize();
+        }
+    }
+
+    root.resize(num_sweeps * num_trees);
+    split_var.clear();
+    cutpoint.clear();
+    child.clear();
+    split_var.reserve(total_nodes);
+    cutpoint.reserve(total_nodes);
+    child.reserve(total_nodes);
+    theta.resize(total_nodes * dim_theta);
+
+    p = 0;
+    size_t index;
+    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    {
+        for (size_t i = 0; i < num_trees; i++)
+        {
+            index = split_var.size();
+            root[sweeps * num_trees + i] = index;
+            split_var.push_back(0);
+            cutpoint.push_back(0.0);
+            child.push_back(0);
+            compile_node(trees[sweeps][i], index);
+        }
+    }
+    number_leaves();
+    return;
+}
+
+void compiled_forest::compile_node(tree &node, size_t index)
+{
+    if (node.getl() == 0)
+    {
+        std::copy(node.theta_vector.begin(), node.theta_vector.end(), theta.begin() + index * dim_theta);
+        return;
+    }
+
+    split_var[index] = node.getv();
+    cutpoint[index] = node.getc();
+    p = std::max(p, node.getv() + 1);
+
+    // allocate both children together
+    size_t left = split_var.size();
+    child[index] = left;
+    split_var.resize(left + 2, 0);
+    cutpoint.resize(left + 2, 0.0);
+    child.resize(left + 2, 0);
+
+    compile_node(*node.getl(), left);
+    compile_node(*node.getr(), left + 1);
+    return;
+}
+
+void compiled_forest::number_leaves()
+{
+    // depth first from each root, left child on top of the stack so leaves are numbered left to right
+    leaf_rank.assign(split_var.size(), 0);
+    std::vector<size_t> stack;
+    size_t index, count;
+    for (size_t t = 0; t < root.size(); t++)
+    {
+        count = 0;
+        stack.push_back(root[t]);
+        while (!stack.empty())
+        {
+            index = stack.back();
+            stack.pop_back();
+            if (child[index])
+            {
+                stack.push_back(child[index] + 1);
+                stack.push_back(child[index]);
+            }
+            else
+            {
+                leaf_rank[index] = count++;
+            }
+        }
+    }
+    return;
+}
+
+void compiled_forest::log_leaves()
+{
+    for (size_t index = 0; index < child.size(); index++)
+    {
+        if (!child[index])
+        {
+            for (size_t k = 0; k < dim_theta; k++)
+            {
+                theta[index * dim_theta + k] = log(theta[index * dim_theta + k]);
+            }
+        }
+    }
+    return;
+}
+
+const double *compiled_forest::search_leaf(const double *row, size_t sweeps, size_t tree_ind) const
+{
+    return leaf_theta(search_leaf_index(row, sweeps, tree_ind));
+}
+
+size_t compiled_forest::search_leaf_index(const double *row, size_t sweeps, size_t tree_ind) const
+{
+    size_t index = root[sweeps * num_trees + tree_ind];
+    while (child[index])
+    {
+        // go left if row[v] <= c, same rule as tree::search_bottom_std
+        index = child[index] + !(row[split_var[index]] <= cutpoint[index]);
+    }
+    return index;
+}
+
+void compiled_forest::path_vars(const double *row, size_t sweeps, size_t tree_ind, std::vector<bool> &active) const
+{
+    size_t index = root[sweeps * num_trees + tree_ind];
+    while (child[index])
+    {
+        active[split_var[index]] = true;
+        index = child[index] + !(row[split_var[index]] <= cutpoint[index]);
+    }
+    return;
+}
+
+void compiled_forest::predict_one(const double *row, double *out) const
+{
+    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    {
+        out[sweeps] = 0.0;
+        for (size_t i = 0; i < num_trees; i++)
+        {
+            out[sweeps] += *search_leaf(row, sweeps, i);
+        }
+    }
+    return;
+}
+
+// binary file layout: magic, version, num_sweeps, num_trees, dim_theta, p, number of nodes (all uint64)
+// followed by p_train, chain, root, split_var, child (uint64) and cutpoint, theta (double) arrays
+// version 1 files have no p_train and chain, they are read as a single chain with unknown p_train
+static const uint64_t compiled_forest_magic = 0x5846524f5458ULL;
+static const uint64_t compiled_forest_version = 2;
+
+template <typename T>
+static void write_vector(std::ostream &out, const std::vector<T> &v)
+{
+    out.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+}
+
+template <typename T>
+static void read_vector(std::istream &in, std::vector<T> &v, size_t n)
+{
+    v.resize(n);
+    in.read(reinterpret_cast<char *>(v.data()), n * sizeof(T));
+}
+
+void compiled_forest::save(std::ostream &out) const
+{
+    std::vector<uint64_t> header = {compiled_forest_magic, compiled_forest_version, num_sweeps, num_trees, dim_theta, p, split_var.size()};
+    write_vector(out, header);
+
+    std::vector<uint64_t> temp(1, p_train);
+    write_vector(out, temp);
+    temp.assign(chain.begin(), chain.end());
+    write_vector(out, temp);
+    temp.assign(root.begin(), root.end());
+    write_vector(out, temp);
+    temp.assign(split_var.begin(), split_var.end());
+    write_vector(out, temp);
+    temp.assign(child.begin(), child.end());
+    write_vector(out, temp);
+    write_vector(out, cutpoint);
+    write_vector(out, theta);
+    return;
+}
+
+bool compiled_forest::load(std::istream &in)
+{
+    // array sizes are bounded by the length of the stream before anything is allocated
+    std::streampos start = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(start);
+    if (start < 0 || end < start || (size_t)(end - start) < 7 * sizeof(uint64_t))
+    {
+        return false;
+    }
+    size_t words = (size_t)(end - start) / sizeof(uint64_t) - 7;
+
+    std::vector<uint64_t> header;
+    read_vector(in, header, 7);
+    if (!in || header[0] != compiled_forest_magic || header[1] < 1 || header[1] > compiled_forest_version)
+    {
+        return false;
+    }
+    bool has_chain = header[1] >= 2; // p_train and chain follow the header
+    num_sweeps = header[2];
+    num_trees = header[3];
+    dim_theta = header[4];
+    p = header[5];
+    size_t total_nodes = header[6];
+
+    // every tree has at least one node, every node one leaf parameter and three index / cutpoint entries
+    if (dim_theta == 0 || num_trees > words || num_sweeps > words || (num_trees > 0 && num_sweeps > words / num_trees) ||
+        total_nodes < num_sweeps * num_trees || total_nodes > words / (3 + dim_theta) ||
+        num_sweeps * num_trees + total_nodes * (3 + dim_theta) + (has_chain ? 1 + num_sweeps : 0) > words)
+    {
+        return false;
+    }
+
+    std::vector<uint64_t> temp;
+    if (has_chain)
+    {
+        read_vector(in, temp, 1);
+        p_train = temp[0];
+        read_vector(in, temp, num_sweeps);
+        chain.assign(temp.begin(), temp.end());
+    }
+    else
+    {
+        p_train = 0;
+        chain.assign(num_sweeps, 0);
+    }
+    read_vector(in, temp, num_sweeps * num_trees);
+    root.assign(temp.begin(), temp.end());
+    read_vector(in, temp, total_nodes);
+    split_var.assign(temp.begin(), temp.end());
+    read_vector(in, temp, total_nodes);
+    child.assign(temp.begin(), temp.end());
+    read_vector(in, cutpoint, total_nodes);
+    read_vector(in, theta, total_nodes * dim_theta);
+    if (!in || !std::is_sorted(chain.begin(), chain.end()) || (p_train > 0 && p_train < p))
+    {
+        return false;
+    }
+
+    // each node is a root or the child of exactly one node, children are stored after their parent and split
+    // variables are below p, so a search stays inside the arrays and every tree is a tree
+    std::vector<bool> reached(total_nodes, false);
+    for (size_t t = 0; t < root.size(); t++)
+    {
+        if (root[t] >= total_nodes || reached[root[t]])
+        {
+            return false;
+        }
+        reached[root[t]] = true;
+    }
+    for (size_t index = 0; index < total_nodes; index++)
+    {
+        if (!child[index])
+        {
+            continue;
+        }
+        if (child[index] <= index || child[index] >= total_nodes - 1 || split_var[index] >= p || reached[child[index]] || reached[child[index] + 1])
+        {
+            return false;
+        }
+        reached[child[index]] = true;
+        reached[child[index] + 1] = true;
+    }
+
+    number_leaves();
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef GUARD_compiled_forest_h
+#define GUARD_compiled_forest_h
+
+#include "tree.h"
+
+// flat, read only copy of a forest for scoring
+// nodes of all trees are stored in contiguous arrays, children of a node are stored next to each other
+// (left child at child[i], right child at child[i] + 1), child[i] == 0 marks a leaf
+// all member functions are const after compile, safe to call from multiple threads
+class compiled_forest
+{
+public:
+    size_t num_sweeps;
+
+    size_t num_trees;
+
+    size_t dim_theta;
+
+    size_t p; // minimal number of columns of input, largest split variable + 1
+
+    size_t p_train; // number of columns of the training data, 0 if unknown (after compile), p_train >= p otherwise
+
+    std::vector<size_t> chain; // chain of each sweep, sweeps are stacked chain by chain, all 0 after compile
+
+    compiled_forest() : num_sweeps(0), num_trees(0), dim_theta(0), p(0), p_train(0) {}
+
+    compiled_forest(std::vector<std::vector<tree>> &trees) { compile(trees); }
+
+    void compile(std::vector<std::vector<tree>> &trees);
+
+    // leaf parameter reached by row in tree tree_ind of sweep sweeps, row is one observation of length p
+    const double *search_leaf(const double *row, size_t sweeps, size_t tree_ind) const;
+
+    // node index of the leaf reached by row, identifies leaf membership across observations
+    size_t search_leaf_index(const double *row, size_t sweeps, size_t tree_ind) const;
+
+    // leaf parameter of a node index returned by search_leaf_index
+    const double *leaf_theta(size_t index) const { return &theta[index * dim_theta]; }
+
+    // position of a leaf among the leaves of its tree, left to right (order of tree::getbots)
+    size_t leaf_number(size_t index) const { return leaf_rank[index]; }
+
+    // set active[v] = true for every split variable on the path of row, active should have length p at least
+    void path_vars(const double *row, size_t sweeps, size_t tree_ind, std::vector<bool> &active) const;
+
+    // prediction of one observation, out[sweeps] is sum of trees (first entry of leaf parameter) of that sweep
+    // out should have length num_sweeps, no memory is allocated
+    void predict_one(const double *row, double *out) const;
+
+    // replace leaf parameters by their log, for models that multiply trees (multinomial)
+    void log_leaves();
+
+    size_t num_nodes() const { return split_var.size(); }
+
+    // binary serialization, native byte order
+    void save(std::ostream &out) const;
+
+    bool load(std::istream &in);
+
+private:
+    std::vector<size_t> root; // index of root node, sweeps * num_trees + tree_ind
+
+    std::vector<size_t> split_var;
+
+    std::vector<double> cutpoint;
+
+    std::vector<size_t> child;
+
+    std::vector<double> theta; // leaf parameters, dim_theta per node
+
+    std::vector<size_t> leaf_rank; // leaf_number of each leaf, 0 for internal nodes
+
+    void compile_node(tree &node, size_t index);
+
+    void number_leaves();
+};
+
+#endif
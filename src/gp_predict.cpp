@@ -0,0 +1,273 @@
+#include "gp_predict.h"
+#include <unordered_map>
+
+// training and test observations routed to one leaf
+struct gp_leaf
+{
+    std::vector<size_t> train;
+    std::vector<size_t> test;
+};
+
+// GP draws for the out of range test points of one leaf, appended to draws as (test index, value)
+static void gp_predict_leaf(const compiled_forest &forest, gp_leaf &leaf, size_t leaf_index, const double *X, const double *Xtest, size_t p, size_t p_continuous,
+                            size_t sweeps, size_t tree_ind, std::vector<double> &resid, double noise, double theta, double tau, size_t max_train,
+                            philox4x32 &gen, std::vector<std::pair<size_t, double>> &draws)
+{
+    size_t N = leaf.train.size();
+
+    // active variables are split variables on the path to the leaf
+    std::vector<bool> active_var(p, false);
+    forest.path_vars(Xtest + leaf.test[0] * p, sweeps, tree_ind, active_var);
+
+    // local range of training data, 95% quantile to avoid outliers, full range if that is degenerate
+    std::vector<double> lower(p_continuous), upper(p_continuous), x_range(p_continuous, 0.0);
+    std::vector<double> values(N);
+    size_t low_idx = (size_t)floor(N * 0.025);
+    size_t up_idx = (size_t)floor(N * 0.975);
+    for (size_t j = 0; j < p_continuous; j++)
+    {
+        if (!active_var[j])
+        {
+            continue;
+        }
+        for (size_t i = 0; i < N; i++)
+        {
+            values[i] = X[leaf.train[i] * p + j];
+        }
+        std::nth_element(values.begin(), values.begin() + low_idx, values.end());
+        lower[j] = values[low_idx];
+        std::nth_element(values.begin(), values.begin() + up_idx, values.end());
+        upper[j] = values[up_idx];
+        if (upper[j] > lower[j])
+        {
+            x_range[j] = upper[j] - lower[j];
+        }
+        else
+        {
+            auto minmax = std::minmax_element(values.begin(), values.end());
+            x_range[j] = *minmax.second - *minmax.first;
+        }
+    }
+
+    // test points out of range on one of the active variables
+    // a variable constant within the leaf has no length scale and is not used
+    std::vector<size_t> test_ind;
+    std::vector<bool> active_var_out_range(p_continuous, false);
+    double x;
+    for (auto &&t : leaf.test)
+    {
+        for (size_t j = 0; j < p_continuous; j++)
+        {
+            if (active_var[j] && x_range[j] > 0)
+            {
+                x = Xtest[t * p + j];
+                if (x > upper[j] || x < lower[j])
+                {
+                    test_ind.push_back(t);
+                    active_var_out_range[j] = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    size_t Ntest = test_ind.size();
+    if (Ntest == 0)
+    {
+        return;
+    }
+
+    size_t p_active = std::accumulate(active_var_out_range.begin(), active_var_out_range.end(), 0);
+    mat X_train(N, p_active);
+    mat X_test(Ntest, p_active);
+    std::vector<double> range(p_active);
+    size_t j_count = 0;
+    for (size_t j = 0; j < p_continuous; j++)
+    {
+        if (active_var_out_range[j])
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                X_train(i, j_count) = X[leaf.train[i] * p + j];
+            }
+            for (size_t i = 0; i < Ntest; i++)
+            {
+                X_test(i, j_count) = Xtest[test_ind[i] * p + j];
+            }
+            range[j_count] = x_range[j];
+            j_count += 1;
+        }
+    }
+
+    double leaf_theta = forest.leaf_theta(leaf_index)[0];
+    mat r(N, 1);
+    for (size_t i = 0; i < N; i++)
+    {
+        r(i, 0) = resid[leaf.train[i]] - leaf_theta;
+    }
+
+    mat cov_test(Ntest, Ntest);
+    get_rel_covariance(cov_test, X_test, range, theta, tau);
+
+    mat mu;
+    mat Sig;
+    if (N <= max_train)
+    {
+        // exact posterior
+        mat cov_train(N, N);
+        get_rel_covariance(cov_train, X_train, range, theta, tau);
+        for (size_t i = 0; i < N; i++)
+        {
+            cov_train(i, i) += noise;
+        }
+        mat k;
+        get_rel_cross_covariance(k, X_test, X_train, range, theta, tau);
+        mat Kinv = pinv(cov_train);
+        mu = k * Kinv * r;
+        Sig = cov_test - k * Kinv * trans(k);
+    }
+    else
+    {
+        // Nystrom approximation on max_train inducing points drawn from the leaf, all training points enter the fit
+        // cost is linear in the leaf size instead of cubic
+        std::vector<size_t> all_ind(N);
+        std::iota(all_ind.begin(), all_ind.end(), 0);
+        std::vector<size_t> inducing_ind(max_train);
+        std::sample(all_ind.begin(), all_ind.end(), inducing_ind.begin(), max_train, gen);
+
+        mat Z(max_train, p_active);
+        for (size_t i = 0; i < max_train; i++)
+        {
+            for (size_t j = 0; j < p_active; j++)
+            {
+                Z(i, j) = X_train(inducing_ind[i], j);
+            }
+        }
+
+        mat cov_inducing(max_train, max_train);
+        get_rel_covariance(cov_inducing, Z, range, theta, tau);
+        mat k_inducing_train;
+        get_rel_cross_covariance(k_inducing_train, Z, X_train, range, theta, tau);
+        mat k_test_inducing;
+        get_rel_cross_covariance(k_test_inducing, X_test, Z, range, theta, tau);
+
+        mat Ainv = pinv(cov_inducing + k_inducing_train * trans(k_inducing_train) / noise);
+        mat Kinv = pinv(cov_inducing);
+        mu = k_test_inducing * Ainv * k_inducing_train * r / noise;
+        Sig = cov_test - k_test_inducing * Kinv * trans(k_test_inducing) + k_test_inducing * Ainv * trans(k_test_inducing);
+    }
+
+    mat U;
+    vec S;
+    mat V;
+    svd(U, S, V, Sig);
+
+    std::normal_distribution<double> normal_samp(0.0, 1.0);
+    mat samp(Ntest, 1);
+    for (size_t i = 0; i < Ntest; i++)
+        samp(i, 0) = normal_samp(gen);
+    mat gp_draws = mu + U * diagmat(sqrt(S)) * samp;
+    for (size_t i = 0; i < Ntest; i++)
+        draws.push_back(std::make_pair(test_ind[i], (double)gp_draws(i, 0)));
+    return;
+}
+
+void gp_predict_forest(const compiled_forest &forest, const double *X, size_t N, const double *Xtest, size_t N_test, size_t p, size_t p_categorical,
+                       matrix<std::vector<double>> &resid, std::vector<double> &sigma, double theta, double tau, size_t max_train, bool parallel, size_t seed,
+                       matrix<double> &yhats_test_xinfo)
+{
+    size_t num_sweeps = forest.num_sweeps;
+    size_t num_trees = forest.num_trees;
+    size_t p_continuous = p - p_categorical; // only work for continuous for now
+    bool use_pool = thread_pool.is_active() && parallel;
+
+    // leaf parameters for all test points
+    const size_t block_size = 1024;
+    size_t n_blocks = (N_test + block_size - 1) / block_size;
+    auto predict_block = [&](size_t block)
+    {
+        std::vector<double> out(num_sweeps);
+        size_t end = std::min((block + 1) * block_size, N_test);
+        for (size_t i = block * block_size; i < end; i++)
+        {
+            forest.predict_one(Xtest + i * p, out.data());
+            for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+            {
+                yhats_test_xinfo[sweeps][i] += out[sweeps];
+            }
+        }
+    };
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (use_pool)
+            thread_pool.add_task(predict_block, block);
+        else
+            predict_block(block);
+    }
+    if (use_pool)
+        thread_pool.wait();
+
+    // GP draws of each (sweep, tree), collected per task and added in a fixed order
+    size_t n_tasks = num_sweeps * num_trees;
+    std::vector<std::vector<std::pair<size_t, double>>> draws(n_tasks);
+    auto predict_tree = [&](size_t task)
+    {
+        size_t sweeps = task / num_trees;
+        size_t tree_ind = task % num_trees;
+
+        philox4x32 gen(seed, sweeps, tree_ind);
+
+        // leaf membership of test points, then of training points in the same leaves
+        std::unordered_map<size_t, size_t> leaf_slot;
+        std::vector<size_t> leaf_index;
+        std::vector<gp_leaf> leaves;
+        size_t index;
+        for (size_t i = 0; i < N_test; i++)
+        {
+            index = forest.search_leaf_index(Xtest + i * p, sweeps, tree_ind);
+            auto it = leaf_slot.find(index);
+            if (it == leaf_slot.end())
+            {
+                it = leaf_slot.emplace(index, leaves.size()).first;
+                leaf_index.push_back(index);
+                leaves.emplace_back();
+            }
+            leaves[it->second].test.push_back(i);
+        }
+        for (size_t i = 0; i < N; i++)
+        {
+            auto it = leaf_slot.find(forest.search_leaf_index(X + i * p, sweeps, tree_ind));
+            if (it != leaf_slot.end())
+            {
+                leaves[it->second].train.push_back(i);
+            }
+        }
+
+        double noise = pow(sigma[sweeps], 2) / num_trees;
+        for (size_t k = 0; k < leaves.size(); k++)
+        {
+            if (leaves[k].train.size() > 0)
+            {
+                gp_predict_leaf(forest, leaves[k], leaf_index[k], X, Xtest, p, p_continuous, sweeps, tree_ind, resid[sweeps][tree_ind], noise, theta, tau, max_train, gen, draws[task]);
+            }
+        }
+    };
+    for (size_t task = 0; task < n_tasks; task++)
+    {
+        if (use_pool)
+            thread_pool.add_task(predict_tree, task);
+        else
+            predict_tree(task);
+    }
+    if (use_pool)
+        thread_pool.wait();
+
+    for (size_t task = 0; task < n_tasks; task++)
+    {
+        for (auto &&d : draws[task])
+        {
+            yhats_test_xinfo[task / num_trees][d.first] += d.second;
+        }
+    }
+    return;
+}
@@ -0,0 +1,18 @@
+#ifndef GUARD_gp_predict_h
+#define GUARD_gp_predict_h
+
+#include "compiled_forest.h"
+#include "utility.h"
+
+// gaussian process extrapolation on a compiled forest
+// in every (sweep, tree), test points outside the 95% range of their leaf training data on a split variable of the leaf path
+// receive a draw from a GP fitted to the leaf residuals, other test points keep the leaf parameter
+// X (N x p) and Xtest (N_test x p) are row major, resid[sweeps][tree_ind] holds the partial residuals of training data
+// sigma[sweeps] is the residual standard deviation of that sweep
+// leaves with more than max_train training points use max_train inducing points (Nystrom approximation) instead of a dense solve
+// (sweep, tree) pairs run on the thread pool when parallel is true, each draws from the counter-based stream (seed, sweep, tree)
+void gp_predict_forest(const compiled_forest &forest, const double *X, size_t N, const double *Xtest, size_t N_test, size_t p, size_t p_categorical,
+                       matrix<std::vector<double>> &resid, std::vector<double> &sigma, double theta, double tau, size_t max_train, bool parallel, size_t seed,
+                       matrix<double> &yhats_test_xinfo);
+
+#endif
@@ -5,8 +5,11 @@
 #include "json_io.h"
 // JSON
 
-json get_forest_json(std::vector<std::vector<tree>> &trees, double y_mean)
+json get_forest_json(std::vector<std::vector<tree>> &trees, double y_mean, const std::vector<size_t> &chain, size_t p)
 {
+    // sweeps of independent chains are stacked chain by chain, chains that stop early contribute fewer sweeps
+    // chain[i] is the (0 based) chain of sweep i, empty for a single chain
+    std::vector<size_t> chain_j = chain.empty() ? std::vector<size_t>(trees.size(), 0) : chain;
     json result;
     result["xbart_version"] = "beta";
     result["xbart_serialization_version"] = 0;
@@ -14,6 +17,12 @@ json get_forest_json(std::vector<std::vector<tree>> &trees, double y_mean)
     result["num_trees"] = trees[0].size();
     result["dim_theta"] = trees[0][0].theta_vector.size();
     result["y_mean"] = y_mean;
+    result["num_chains"] = chain_j.empty() ? 1 : chain_j.back() + 1;
+    result["chain"] = chain_j;
+    if (p > 0)
+    {
+        result["p"] = p;
+    }
 
     json trees_j;
     // auto jsonObjects = json::array();
@@ -33,6 +42,14 @@ json get_forest_json(std::vector<std::vector<tree>> &trees, double y_mean)
 }
 
 void from_json_to_forest(std::string &json_string, vector<vector<tree>> &trees, double &y_mean)
+{
+    std::vector<size_t> chain;
+    size_t p;
+    from_json_to_forest(json_string, trees, y_mean, chain, p);
+    return;
+}
+
+void from_json_to_forest(std::string &json_string, vector<vector<tree>> &trees, double &y_mean, std::vector<size_t> &chain, size_t &p)
 {
     auto j3 = json::parse(json_string);
 
@@ -61,6 +78,26 @@ void from_json_to_forest(std::string &json_string, vector<vector<tree>> &trees,
             trees[i][j].from_json(j3["trees"][std::to_string(i)][std::to_string(j)], dim_theta);
         }
     }
+
+    // models saved before chains were recorded are a single chain
+    if (j3.contains("chain"))
+    {
+        chain = j3.at("chain").get<std::vector<size_t>>();
+        if (chain.size() != num_sweeps || !std::is_sorted(chain.begin(), chain.end()))
+        {
+            throw std::invalid_argument("chain of the saved forest does not match its sweeps");
+        }
+    }
+    else
+    {
+        chain.assign(num_sweeps, 0);
+    }
+
+    p = 0;
+    if (j3.contains("p"))
+    {
+        j3.at("p").get_to(p);
+    }
     return;
 }
 
@@ -3,10 +3,15 @@
 
 #include "tree.h"
 
-json get_forest_json(std::vector<std::vector<tree>> &trees, double y_mean);
+// p is the number of columns of the training data, 0 if unknown
+json get_forest_json(std::vector<std::vector<tree>> &trees, double y_mean, const std::vector<size_t> &chain = std::vector<size_t>(), size_t p = 0);
 
 void from_json_to_forest(std::string &json_string, vector<vector<tree>> &trees, double &y_mean);
 
+// also reads the chain of each sweep, all 0 for models saved without it, and the number of columns of the
+// training data, 0 for models saved without it
+void from_json_to_forest(std::string &json_string, vector<vector<tree>> &trees, double &y_mean, std::vector<size_t> &chain, size_t &p);
+
 json get_forest_json_3D(std::vector<std::vector<std::vector<tree>>> &trees);
 
 void from_json_to_forest_3D(std::string &json_string, vector<vector<vector<tree>>> &trees);
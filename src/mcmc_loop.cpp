@@ -4,12 +4,58 @@
 
 #include "mcmc_loop.h"
 
-void mcmc_loop(matrix<size_t> &Xorder_std, bool verbose, matrix<double> &sigma_draw_xinfo, vector<vector<tree>> &trees, double no_split_penalty, State &state, NormalModel *model, X_struct &x_struct, std::vector<double> &resid)
+// early stopping rule, evaluated at the end of each sweep
+// a sweep is stable if every trace changed by at most stop_tol relative to the previous sweep
+// sweeps stop after stop_patience consecutive stable sweeps, never before the first sweep after burnin
+static bool stop_sweeps(State &state, size_t sweeps, std::vector<double> &trace, std::vector<double> &trace_last, size_t &stable_sweeps)
+{
+    state.num_sweeps_run = sweeps + 1;
+    if (state.stop_tol <= 0)
+    {
+        return false;
+    }
+
+    bool stable = sweeps > 0;
+    for (size_t i = 0; i < trace.size() && stable; i++)
+    {
+        stable = fabs(trace[i] - trace_last[i]) <= state.stop_tol * fabs(trace_last[i]);
+    }
+    trace_last = trace;
+    stable_sweeps = stable ? stable_sweeps + 1 : 0;
+
+    return sweeps >= state.burnin && stable_sweeps >= state.stop_patience;
+}
+
+void mcmc_loop(matrix<size_t> &Xorder_std, bool verbose, matrix<double> &sigma_draw_xinfo, vector<vector<tree>> &trees, double no_split_penalty, State &state, NormalModel *model, X_struct &x_struct, std::vector<double> &resid, vector<vector<tree>> *warm_start_trees)
 {
     size_t N = (*state.residual_std)[0].size();
 
-    // initialize the matrix of residuals
-    model->ini_residual_std(state);
+    if (warm_start_trees)
+    {
+        // continue from the last sweep of a saved forest, sigma is drawn from its residuals at the first tree
+        size_t last_sweep = warm_start_trees->size() - 1;
+        model->copy_initialization(state, x_struct, (*warm_start_trees)[last_sweep]);
+        if (model->sampling_tau)
+        {
+            model->update_tau_per_forest(state, last_sweep, *warm_start_trees);
+        }
+    }
+    else
+    {
+        // initialize the matrix of residuals
+        model->ini_residual_std(state);
+    }
+
+    // traces of the stopping rule, mean sigma, in-sample root mean squared error and mean tree size
+    std::vector<double> trace(3), trace_last(3);
+    size_t stable_sweeps = 0;
+
+    // buffers of the row subsample that each tree is grown on
+    bool subsample = state.subsample < 1.0;
+    std::vector<bool> row_in(subsample ? N : 0);
+    matrix<size_t> Xorder_sub_std;
+    std::vector<size_t> X_counts_sub;
+    std::vector<size_t> X_num_unique_sub;
 
     for (size_t sweeps = 0; sweeps < state.num_sweeps; sweeps++)
     {
@@ -48,16 +94,34 @@ void mcmc_loop(matrix<size_t> &Xorder_std, bool verbose, matrix<double> &sigma_d
                 (*state.mtry_weight_current_tree) = (*state.mtry_weight_current_tree) - (*state.split_count_all_tree)[tree_ind];
             }
 
-            // initialize sufficient statistics of the current tree to be updated
-            model->initialize_root_suffstat(state, trees[sweeps][tree_ind].suff_stat);
-
             if (state.parallel)
             {
                 trees[sweeps][tree_ind].settau(model->tau_prior, model->tau); // initiate tau
             }
 
-            // main function to grow the tree from root
-            trees[sweeps][tree_ind].grow_from_root(state, Xorder_std, x_struct.X_counts, x_struct.X_num_unique, model, x_struct, sweeps, tree_ind);
+            if (subsample)
+            {
+                // grow the tree on a row subsample, then fit leaf parameters with all rows
+                subsample_xorder_std(state, x_struct, Xorder_std, row_in, Xorder_sub_std, X_counts_sub, X_num_unique_sub);
+
+                trees[sweeps][tree_ind].suff_stat.assign(model->dim_suffstat, 0.0);
+                for (auto &&i : Xorder_sub_std[0])
+                {
+                    model->incSuffStat(state, i, trees[sweeps][tree_ind].suff_stat);
+                }
+
+                trees[sweeps][tree_ind].grow_from_root(state, Xorder_sub_std, X_counts_sub, X_num_unique_sub, model, x_struct, sweeps, tree_ind);
+
+                trees[sweeps][tree_ind].fit_leaves_all_rows(state, model, x_struct, tree_ind);
+            }
+            else
+            {
+                // initialize sufficient statistics of the current tree to be updated
+                model->initialize_root_suffstat(state, trees[sweeps][tree_ind].suff_stat);
+
+                // main function to grow the tree from root
+                trees[sweeps][tree_ind].grow_from_root(state, Xorder_std, x_struct.X_counts, x_struct.X_num_unique, model, x_struct, sweeps, tree_ind);
+            }
 
             // set id for bottom nodes
             tree::npv bv;
@@ -85,7 +149,7 @@ void mcmc_loop(matrix<size_t> &Xorder_std, bool verbose, matrix<double> &sigma_d
             state.update_split_counts(tree_ind);
 
             // update partial residual for the next tree to fit
-            model->state_sweep(tree_ind, state.num_trees, (*state.residual_std), x_struct);
+            model->state_sweep(tree_ind, state.num_trees, state, x_struct);
         }
 
         if (model->sampling_tau)
@@ -93,6 +157,19 @@ void mcmc_loop(matrix<size_t> &Xorder_std, bool verbose, matrix<double> &sigma_d
             // update tau per sweep (after drawing a forest)
             model->update_tau_per_forest(state, sweeps, trees);
         }
+
+        trace[0] = std::accumulate(sigma_draw_xinfo[sweeps].begin(), sigma_draw_xinfo[sweeps].end(), 0.0) / state.num_trees;
+        trace[1] = sqrt(state.full_residual_ss / state.n_y);
+        trace[2] = 0.0;
+        for (size_t tree_ind = 0; tree_ind < state.num_trees; tree_ind++)
+        {
+            trace[2] += trees[sweeps][tree_ind].treesize();
+        }
+        trace[2] /= state.num_trees;
+        if (stop_sweeps(state, sweeps, trace, trace_last, stable_sweeps))
+        {
+            break;
+        }
     }
     return;
 }
@@ -109,6 +186,10 @@ void mcmc_loop_multinomial(matrix<size_t> &Xorder_std, bool verbose, vector<vect
     size_t count_lambda = (state.num_trees - 1) * model->dim_residual; // less the lambdas in the first tree
     std::vector<double> var_lambda(state.num_trees, 0.0);
 
+    // traces of the stopping rule, mean logloss and mean tree size
+    std::vector<double> trace(2), trace_last(2);
+    size_t stable_sweeps = 0;
+
     for (size_t sweeps = 0; sweeps < state.num_sweeps; sweeps++)
     {
 
@@ -156,7 +237,7 @@ void mcmc_loop_multinomial(matrix<size_t> &Xorder_std, bool verbose, vector<vect
             // update partial fits for the next tree
             model->update_state(state, tree_ind, x_struct, mean_lambda, var_lambda, count_lambda);
 
-            model->state_sweep(tree_ind, state.num_trees, (*state.residual_std), x_struct);
+            model->state_sweep(tree_ind, state.num_trees, state, x_struct);
 
             weight_samples[sweeps][tree_ind] = model->weight;
             phi_samples[sweeps][tree_ind] = exp((*model->phi)[0]);
@@ -182,6 +263,13 @@ void mcmc_loop_multinomial(matrix<size_t> &Xorder_std, bool verbose, vector<vect
             }
         }
         model->update_weights(state, x_struct, mean_lambda, var_lambda, count_lambda);
+
+        trace[0] = std::accumulate(logloss[sweeps].begin(), logloss[sweeps].end(), 0.0) / state.num_trees;
+        trace[1] = std::accumulate(tree_size[sweeps].begin(), tree_size[sweeps].end(), 0.0) / state.num_trees;
+        if (stop_sweeps(state, sweeps, trace, trace_last, stable_sweeps))
+        {
+            break;
+        }
     }
 }
 
@@ -202,6 +290,24 @@ void mcmc_loop_multinomial_sample_per_tree(matrix<size_t> &Xorder_std, bool verb
     size_t count_lambda = (state.num_trees - 1) * model->dim_residual; // less the lambdas in the first tree
     std::vector<double> var_lambda(state.num_trees, 0.0);
 
+    // the class trees of one tree index only read the residuals, so they are grown concurrently
+    // each class has its own copy of the model (class_operating), its own split count buffer and random number stream
+    // the remaining members of the state copies point to the shared, read-only data
+    bool parallel_classes = thread_pool.is_active() && state.parallel;
+    std::vector<State> class_states(model->dim_residual, state);
+    std::vector<LogitModelSeparateTrees> class_models(model->dim_residual, *model);
+    matrix<double> class_split_counts;
+    ini_matrix(class_split_counts, p, model->dim_residual);
+    for (size_t class_ind = 0; class_ind < model->dim_residual; class_ind++)
+    {
+        class_states[class_ind].parallel = false; // the split search inside a class task runs serially
+        class_states[class_ind].split_count_current_tree = &class_split_counts[class_ind];
+    }
+
+    // traces of the stopping rule, mean logloss and mean tree size
+    std::vector<double> trace(2), trace_last(2);
+    size_t stable_sweeps = 0;
+
     for (size_t sweeps = 0; sweeps < state.num_sweeps; sweeps++)
     {
 
@@ -239,17 +345,42 @@ void mcmc_loop_multinomial_sample_per_tree(matrix<size_t> &Xorder_std, bool verb
 
             for (size_t class_ind = 0; class_ind < model->dim_residual; class_ind++)
             {
-                model->set_class_operating(class_ind);
+                // refresh the per-class copies, weight and tau_a are updated after every tree
+                class_models[class_ind] = *model;
+                class_models[class_ind].set_class_operating(class_ind);
+
+                class_states[class_ind].use_all = state.use_all;
+                class_states[class_ind].gen.seed(state.gen());
+                std::fill(class_split_counts[class_ind].begin(), class_split_counts[class_ind].end(), 0.0);
 
                 (*state.lambdas_separate)[tree_ind][class_ind].clear();
 
-                model->initialize_root_suffstat(state, trees[class_ind][sweeps][tree_ind].suff_stat);
+                auto grow_class = [&, class_ind]()
+                {
+                    class_models[class_ind].initialize_root_suffstat(class_states[class_ind], trees[class_ind][sweeps][tree_ind].suff_stat);
+
+                    trees[class_ind][sweeps][tree_ind].theta_vector.resize(model->dim_residual);
 
-                trees[class_ind][sweeps][tree_ind].theta_vector.resize(model->dim_residual);
+                    trees[class_ind][sweeps][tree_ind].grow_from_root_separate_tree(class_states[class_ind], Xorder_std, x_struct.X_counts, x_struct.X_num_unique, &class_models[class_ind], x_struct, sweeps, tree_ind);
+                };
+
+                if (parallel_classes)
+                    thread_pool.add_task(grow_class);
+                else
+                    grow_class();
+            }
 
-                trees[class_ind][sweeps][tree_ind].grow_from_root_separate_tree(state, Xorder_std, x_struct.X_counts, x_struct.X_num_unique, model, x_struct, sweeps, tree_ind);
+            if (parallel_classes)
+                thread_pool.wait();
 
+            for (size_t class_ind = 0; class_ind < model->dim_residual; class_ind++)
+            {
                 tree_size[sweeps][tree_ind] += trees[class_ind][sweeps][tree_ind].treesize();
+
+                for (size_t i = 0; i < p; i++)
+                {
+                    (*state.split_count_current_tree)[i] += class_split_counts[class_ind][i];
+                }
             }
 
             state.update_split_counts(tree_ind);
@@ -273,10 +404,23 @@ void mcmc_loop_multinomial_sample_per_tree(matrix<size_t> &Xorder_std, bool verb
                 COUT << " tree " << tree_ind << " logloss " << model->logloss << endl;
             }
 
-            model->state_sweep(tree_ind, state.num_trees, (*state.residual_std), x_struct);
+            model->state_sweep(tree_ind, state.num_trees, state, x_struct);
+        }
+
+        trace[0] = std::accumulate(logloss[sweeps].begin(), logloss[sweeps].end(), 0.0) / state.num_trees;
+        trace[1] = std::accumulate(tree_size[sweeps].begin(), tree_size[sweeps].end(), 0.0) / state.num_trees;
+        if (stop_sweeps(state, sweeps, trace, trace_last, stable_sweeps))
+        {
+            break;
         }
     }
 
+    for (size_t class_ind = 0; class_ind < model->dim_residual; class_ind++)
+    {
+        state.nodes_serial += class_states[class_ind].nodes_serial;
+        state.nodes_parallel += class_states[class_ind].nodes_parallel;
+    }
+
     return;
 }
 
@@ -630,7 +774,6 @@ void mcmc_loop_heteroskedastic(matrix<size_t> &Xorder_std,
 
             mean_model->initialize_root_suffstat(state, mean_trees[sweeps][tree_ind].suff_stat);
 
-            // single core
             mean_trees[sweeps][tree_ind].grow_from_root(state, Xorder_std, mean_x_struct.X_counts, mean_x_struct.X_num_unique, mean_model, mean_x_struct, sweeps, tree_ind);
 
             // update tau after sampling the tree
@@ -677,13 +820,12 @@ void mcmc_loop_heteroskedastic(matrix<size_t> &Xorder_std,
 
             var_model->initialize_root_suffstat(state, var_trees[sweeps][tree_ind].suff_stat);
 
-            // single core
             var_trees[sweeps][tree_ind].grow_from_root(state, Xorder_std, var_x_struct.X_counts, var_x_struct.X_num_unique, var_model, var_x_struct, sweeps, tree_ind);
 
             state.update_split_counts(tree_ind);
 
             // update partial residual for the next tree to fit
-            var_model->state_sweep(tree_ind, state.num_trees, (*state.residual_std), var_x_struct);
+            var_model->state_sweep(tree_ind, state.num_trees, state, var_x_struct);
         }
 
         // pass fitted values for sigmas to the mean model
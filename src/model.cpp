@@ -4,6 +4,7 @@
 
 #include "tree.h"
 #include "model.h"
+#include "compiled_forest.h"
 #include <cfenv>
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -35,15 +36,9 @@ void NormalModel::samplePars(State &state, std::vector<double> &suff_stat, std::
 void NormalModel::update_state(State &state, size_t tree_ind, X_struct &x_struct)
 {
     // This function updates sigma, residual variance
+    // sum of squared full residuals is maintained by ini_residual_std and state_sweep
 
-    std::vector<double> full_residual(state.n_y);
-
-    for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
-    {
-        full_residual[i] = (*state.residual_std)[0][i] - (*(x_struct.data_pointers[tree_ind][i]))[0];
-    }
-
-    std::gamma_distribution<double> gamma_samp((state.n_y + kap) / 2.0, 2.0 / (sum_squared(full_residual) + s));
+    std::gamma_distribution<double> gamma_samp((state.n_y + kap) / 2.0, 2.0 / (state.full_residual_ss + s));
     state.update_sigma(1.0 / sqrt(gamma_samp(state.gen)));
     return;
 }
@@ -90,13 +85,10 @@ void NormalModel::update_tau_per_forest(State &state, size_t sweeps, vector<vect
 
 void NormalModel::initialize_root_suffstat(State &state, std::vector<double> &suff_stat)
 {
-    // this function calculates sufficient statistics at the root node when growing a new tree
-    // sum of y
-    suff_stat[0] = sum_vec((*state.residual_std)[0]);
-    // sum of y squared
-    suff_stat[1] = sum_squared((*state.residual_std)[0]);
-    // number of observations in the node
-    suff_stat[2] = state.n_y;
+    // this function sets sufficient statistics at the root node when growing a new tree
+    // sum of y, sum of y squared and number of observations are accumulated by ini_residual_std and state_sweep
+    // in the same pass that updates the residuals
+    suff_stat = state.root_suff_stat;
     return;
 }
 
@@ -128,20 +120,66 @@ void NormalModel::calculateOtherSideSuffStat(std::vector<double> &parent_suff_st
     return;
 }
 
-void NormalModel::state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const
+void NormalModel::state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const
 {
     // this function updates the residual vector (fitting target) for the next tree when the current tree was grown
+    // the same pass accumulates the sum of squared full residuals for the next sigma draw
+    // and the root sufficient statistics of the next tree
+    // blocks of observations run on the thread pool, partial sums are reduced in block order
     size_t next_index = tree_ind + 1;
     if (next_index == M)
     {
         next_index = 0;
     }
 
-    for (size_t i = 0; i < residual_std[0].size(); i++)
+    std::vector<double> &residual_std = (*state.residual_std)[0];
+    std::vector<std::vector<double> *> &fit_current = x_struct.data_pointers[tree_ind];
+    std::vector<std::vector<double> *> &fit_next = x_struct.data_pointers[next_index];
+
+    const size_t block_size = 8192;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+    std::vector<double> block_full_residual_ss(n_blocks, 0.0);
+    std::vector<double> block_sum(n_blocks, 0.0);
+    std::vector<double> block_sum_squared(n_blocks, 0.0);
+
+    auto sweep_block = [&](size_t block)
     {
-        // residual becomes subtracting the current grown tree, add back the next tree
-        residual_std[0][i] = residual_std[0][i] - (*(x_struct.data_pointers[tree_ind][i]))[0] + (*(x_struct.data_pointers[next_index][i]))[0];
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+        double full_residual, residual;
+        double full_residual_ss = 0.0, sum = 0.0, sum_squared = 0.0;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            // residual becomes subtracting the current grown tree, add back the next tree
+            full_residual = residual_std[i] - (*fit_current[i])[0];
+            residual = full_residual + (*fit_next[i])[0];
+            residual_std[i] = residual;
+
+            full_residual_ss += full_residual * full_residual;
+            sum += residual;
+            sum_squared += residual * residual;
+        }
+        block_full_residual_ss[block] = full_residual_ss;
+        block_sum[block] = sum;
+        block_sum_squared[block] = sum_squared;
+    };
+
+    bool parallel_sweep = thread_pool.is_active() && state.parallel && n_blocks > 1;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (parallel_sweep)
+            thread_pool.add_task(sweep_block, block);
+        else
+            sweep_block(block);
     }
+    if (parallel_sweep)
+        thread_pool.wait();
+
+    state.full_residual_ss = std::accumulate(block_full_residual_ss.begin(), block_full_residual_ss.end(), 0.0);
+    state.root_suff_stat[0] = std::accumulate(block_sum.begin(), block_sum.end(), 0.0);
+    state.root_suff_stat[1] = std::accumulate(block_sum_squared.begin(), block_sum_squared.end(), 0.0);
+    state.root_suff_stat[2] = state.n_y;
     return;
 }
 
@@ -214,10 +252,77 @@ void NormalModel::ini_residual_std(State &state)
 {
     // initialize partial residual at (num_tree - 1) / num_tree * yhat
     double value = state.ini_var_yhat * ((double)state.num_trees - 1.0) / (double)state.num_trees;
+    state.full_residual_ss = 0.0;
+    state.root_suff_stat.assign(dim_suffstat, 0.0);
     for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
     {
         (*state.residual_std)[0][i] = (*state.y_std)[i] - value;
+        // every tree starts at ini_var_yhat / num_trees
+        state.full_residual_ss += pow((*state.y_std)[i] - state.ini_var_yhat, 2);
+        state.root_suff_stat[0] += (*state.residual_std)[0][i];
+        state.root_suff_stat[1] += pow((*state.residual_std)[0][i], 2);
+    }
+    state.root_suff_stat[2] = state.n_y;
+    return;
+}
+
+void NormalModel::copy_initialization(State &state, X_struct &x_struct, vector<tree> &warm_trees)
+{
+    // warm start from one sweep of a saved forest instead of the constant initial fit
+    // leaf pointers of every tree point to leaves of warm_trees until that tree is grown again in the first sweep
+    // so warm_trees must outlive the first sweep
+    // the partial residual of the first tree and the sufficient statistics follow the fit of the warm forest
+    std::vector<double> &residual_std = (*state.residual_std)[0];
+
+    const size_t block_size = 8192;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+    std::vector<double> block_full_residual_ss(n_blocks, 0.0);
+    std::vector<double> block_sum(n_blocks, 0.0);
+    std::vector<double> block_sum_squared(n_blocks, 0.0);
+
+    auto copy_block = [&](size_t block)
+    {
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+        double fit, full_residual;
+        double full_residual_ss = 0.0, sum = 0.0, sum_squared = 0.0;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            fit = 0.0;
+            for (size_t tree_ind = 0; tree_ind < state.num_trees; tree_ind++)
+            {
+                x_struct.data_pointers[tree_ind][i] = &warm_trees[tree_ind].search_bottom_std(state.X_std, i, state.p, state.n_y)->theta_vector;
+                fit += (*x_struct.data_pointers[tree_ind][i])[0];
+            }
+            full_residual = (*state.y_std)[i] - fit;
+            residual_std[i] = full_residual + (*x_struct.data_pointers[0][i])[0];
+
+            full_residual_ss += full_residual * full_residual;
+            sum += residual_std[i];
+            sum_squared += residual_std[i] * residual_std[i];
+        }
+        block_full_residual_ss[block] = full_residual_ss;
+        block_sum[block] = sum;
+        block_sum_squared[block] = sum_squared;
+    };
+
+    bool parallel_copy = thread_pool.is_active() && state.parallel && n_blocks > 1;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (parallel_copy)
+            thread_pool.add_task(copy_block, block);
+        else
+            copy_block(block);
     }
+    if (parallel_copy)
+        thread_pool.wait();
+
+    state.full_residual_ss = std::accumulate(block_full_residual_ss.begin(), block_full_residual_ss.end(), 0.0);
+    state.root_suff_stat.assign(dim_suffstat, 0.0);
+    state.root_suff_stat[0] = std::accumulate(block_sum.begin(), block_sum.end(), 0.0);
+    state.root_suff_stat[1] = std::accumulate(block_sum_squared.begin(), block_sum_squared.end(), 0.0);
+    state.root_suff_stat[2] = state.n_y;
     return;
 }
 
@@ -270,6 +375,71 @@ void NormalModel::predict_whole_std(const double *Xtestpointer, size_t N_test, s
     return;
 }
 
+void NormalModel::predict_leaf_std(const std::vector<uint16_t> &leaf_index, matrix<double> &leaf_values, size_t N_test, size_t num_trees, size_t num_sweeps, matrix<double> &yhats_test_xinfo)
+{
+    // predict from precomputed leaf index (see getLeafIndex_Outsample), no tree traversal
+    // leaf_values[sweeps + i * num_sweeps] are the leaf parameters of tree i in sweep sweeps
+    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    {
+        for (size_t i = 0; i < num_trees; i++)
+        {
+            const std::vector<double> &values = leaf_values[sweeps + i * num_sweeps];
+            const uint16_t *index = &leaf_index[sweeps * N_test + i * num_sweeps * N_test];
+            for (size_t data_ind = 0; data_ind < N_test; data_ind++)
+            {
+                yhats_test_xinfo[sweeps][data_ind] += values[index[data_ind]];
+            }
+        }
+    }
+    return;
+}
+
+void NormalModel::predict_summary_std(const double *Xtestpointer, size_t N_test, size_t p, size_t num_trees, const std::vector<size_t> &sweeps_kept, const std::vector<double> &quantiles, std::vector<double> &mean_vec, std::vector<double> &var_vec, matrix<double> &quantile_xinfo, vector<vector<tree>> &trees)
+{
+    // posterior mean, variance and quantiles of the prediction for each testing observation
+    // only sweeps in sweeps_kept are summarized (e.g. after the burnin of every chain), draws are summarized
+    // one row at a time so only a buffer of sweeps_kept.size() draws is kept instead of the N_test * num_sweeps matrix
+    // quantile_xinfo : row is testing observation, column is quantile
+    size_t num_draws = sweeps_kept.size();
+    std::vector<double> draws(num_draws);
+    std::vector<double> quantile_temp(quantiles.size());
+
+    double yhat;
+    double delta;
+    for (size_t data_ind = 0; data_ind < N_test; data_ind++)
+    {
+        // Welford's online update of mean and sum of squared deviations
+        double mean = 0.0;
+        double m2 = 0.0;
+        for (size_t draw = 0; draw < num_draws; draw++)
+        {
+            yhat = 0.0;
+            for (size_t i = 0; i < num_trees; i++)
+            {
+                yhat += trees[sweeps_kept[draw]][i].search_bottom_std(Xtestpointer, data_ind, p, N_test)->theta_vector[0];
+            }
+            draws[draw] = yhat;
+
+            delta = yhat - mean;
+            mean += delta / (double)(draw + 1);
+            m2 += delta * (yhat - mean);
+        }
+
+        mean_vec[data_ind] = mean;
+        var_vec[data_ind] = num_draws > 1 ? m2 / (double)(num_draws - 1) : 0.0;
+
+        if (quantiles.size() > 0)
+        {
+            vec_quantile(draws, quantiles, quantile_temp);
+            for (size_t k = 0; k < quantiles.size(); k++)
+            {
+                quantile_xinfo[k][data_ind] = quantile_temp[k];
+            }
+        }
+    }
+    return;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 //
@@ -285,8 +455,8 @@ void LogitModel::incSuffStat(State &state, size_t index_next_obs, std::vector<do
     suffstats[(*y_size_t)[index_next_obs]] += weight;
     for (size_t j = 0; j < dim_theta; ++j)
     {
-        // suffstats[dim_residual + j] += weight * exp((*state.residual_std)[j][index_next_obs]);
-        suffstats[dim_residual + j] += weight * exp((*phi)[index_next_obs] + (*state.residual_std)[j][index_next_obs]);
+        // exp(phi + residual), both factors are cached in state
+        suffstats[dim_residual + j] += weight * (*state.exp_phi)[index_next_obs] * (*state.exp_residual_std)[j][index_next_obs];
     }
 
     return;
@@ -315,11 +485,11 @@ void LogitModel::samplePars(State &state, std::vector<double> &suff_stat, std::v
             // set the first category as baseline. always 1 or 0 in logscale
             // theta_vector[j] = pow(1.0 / dim_theta, 1.0 / state.num_trees);
 
-            theta_vector[j] = drawlambdafromR(n, sy, c, d, state.gen);
+            theta_vector[j] = drawlambda(n, sy, c, d, state.gen);
         }
         else
         {
-            theta_vector[j] = drawlambdafromR(n, sy, c, d, state.gen); //(n, sy, c, d, gen);
+            theta_vector[j] = drawlambda(n, sy, c, d, state.gen); //(n, sy, c, d, gen);
         }
     }
     return;
@@ -327,69 +497,104 @@ void LogitModel::samplePars(State &state, std::vector<double> &suff_stat, std::v
 
 void LogitModel::update_state(State &state, size_t tree_ind, X_struct &x_struct, double &mean_lambda, std::vector<double> &var_lambda, size_t &count_lambda)
 {
-    // update residuals
-    for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
+    // one fused pass over blocks of observations: update residuals, then accuracy, phi and logloss
+    // blocks run on the thread pool, each draws phi from its own counter-based stream keyed by (seed, tree, block)
+    // so the draws do not depend on the number of threads, per-block sums are reduced in block order
+    const size_t block_size = 2048;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+    std::vector<double> block_logloss(n_blocks, 0.0);
+    matrix<double> block_acc_gp;
+    matrix<double> block_count_gp;
+    ini_matrix(block_acc_gp, dim_residual, n_blocks);
+    ini_matrix(block_count_gp, dim_residual, n_blocks);
+    uint64_t seed = state.gen();
+
+    matrix<double> &residual_std = *state.residual_std;
+    matrix<double> &exp_residual_std = *state.exp_residual_std;
+    std::vector<std::vector<double> *> &theta_pointers = x_struct.data_pointers[tree_ind];
+
+    auto update_block = [&](size_t block)
     {
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+
+        // update residuals, class by class
         for (size_t j = 0; j < dim_theta; ++j)
         {
-            (*state.residual_std)[j][i] = (*state.residual_std)[j][i] + log((*(x_struct.data_pointers[tree_ind][i]))[j]);
+            double *resid_j = residual_std[j].data();
+            double *exp_resid_j = exp_residual_std[j].data();
+            for (size_t i = begin; i < end; i++)
+            {
+                double theta = (*theta_pointers[i])[j];
+                resid_j[i] += log(theta);
+                exp_resid_j[i] *= theta;
+            }
         }
-    }
 
-    // // check residauls
-    // std::vector<double> residual_sample(dim_residual);
-    // for (size_t j = 0; j < dim_residual; j++)
-    // {
-    //     residual_sample[j] = exp((*phi)[0] + (*state.residual_std)[j][0]);
-    // }
-    // cout << "phi " << (*phi)[0] << " exp(phi) " << exp((*phi)[0]) << " residuals " << residual_sample << endl;
-
-    // track accuracy of each group
-    std::fill(acc_gp.begin(), acc_gp.end(), 0.0);
-    std::vector<double> count_gp(dim_residual, 0.0);
-    size_t yhat = 0;
-    double max_resid = -INFINITY;
-
-    // Calculate logloss
-    size_t y_i;
-    double sum_fits;
-    logloss = 0; // reset logloss
-    double prob = 0.0;
-    std::gamma_distribution<double> gammadist(1.0, 1.0);
+        philox4x32 gen(seed, tree_ind, block);
+        std::gamma_distribution<double> gammadist(1.0, 1.0);
 
-    double temp;
-    double temp_sum;
+        std::vector<double> &acc = block_acc_gp[block];
+        std::vector<double> &count = block_count_gp[block];
+        size_t y_i, yhat;
+        double sum_fits, max_resid;
+        double loss = 0.0;
 
-    for (size_t i = 0; i < state.n_y; i++)
-    {
-        sum_fits = 0;
-        y_i = (size_t)(*y_size_t)[i];
-        yhat = 0;
-        max_resid = -INFINITY;
-        for (size_t j = 0; j < dim_residual; ++j)
+        for (size_t i = begin; i < end; i++)
         {
-            sum_fits += exp((*state.residual_std)[j][i]);
-            if ((*state.residual_std)[j][i] > max_resid)
+            sum_fits = 0;
+            y_i = (size_t)(*y_size_t)[i];
+            yhat = 0;
+            max_resid = -INFINITY;
+            for (size_t j = 0; j < dim_residual; ++j)
             {
-                yhat = j;
-                max_resid = (*state.residual_std)[j][i];
+                sum_fits += exp_residual_std[j][i];
+                if (residual_std[j][i] > max_resid)
+                {
+                    yhat = j;
+                    max_resid = residual_std[j][i];
+                }
             }
-        }
 
-        count_gp[y_i] += 1;
-        if (yhat == y_i)
-        {
-            acc_gp[y_i] += 1;
+            count[y_i] += 1;
+            if (yhat == y_i)
+            {
+                acc[y_i] += 1;
+            }
+            // Sample phi
+            if (update_phi)
+            {
+                (*state.exp_phi)[i] = gammadist(gen) / sum_fits;
+                (*phi)[i] = log((*state.exp_phi)[i]);
+            }
+            // calculate logloss, logloss =  - log(p_j)
+            loss += -log(exp_residual_std[y_i][i] / sum_fits);
         }
-        // Sample phi
-        if (update_phi)
+        block_logloss[block] = loss;
+    };
+
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (thread_pool.is_active() && state.parallel)
+            thread_pool.add_task(update_block, block);
+        else
+            update_block(block);
+    }
+    if (thread_pool.is_active() && state.parallel)
+        thread_pool.wait();
+
+    // track accuracy of each group
+    std::fill(acc_gp.begin(), acc_gp.end(), 0.0);
+    std::vector<double> count_gp(dim_residual, 0.0);
+    logloss = 0; // reset logloss
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        logloss += block_logloss[block];
+        for (size_t j = 0; j < dim_residual; j++)
         {
-            (*phi)[i] = log(gammadist(state.gen)) - log(1.0 * sum_fits);
+            acc_gp[j] += block_acc_gp[block][j];
+            count_gp[j] += block_count_gp[block][j];
         }
-        // calculate logloss
-        prob = exp((*state.residual_std)[y_i][i]) / sum_fits; // logloss =  - log(p_j)
-
-        logloss += -log(prob);
     }
 
     // std::vector<double> resid_samples(dim_residual);
@@ -572,7 +777,7 @@ void LogitModel::update_weights(State &state, X_struct &x_struct, double &mean_l
             max_resid = -INFINITY;
             for (size_t j = 0; j < dim_residual; ++j)
             {
-                sum_fits += exp((*state.residual_std)[j][i]);
+                sum_fits += (*state.exp_residual_std)[j][i];
                 if ((*state.residual_std)[j][i] > max_resid)
                 {
                     yhat = j;
@@ -588,10 +793,11 @@ void LogitModel::update_weights(State &state, X_struct &x_struct, double &mean_l
             // Sample phi
             if (update_phi)
             {
-                (*phi)[i] = log(gammadist(state.gen)) - log(1.0 * sum_fits);
+                (*state.exp_phi)[i] = gammadist(state.gen) / sum_fits;
+                (*phi)[i] = log((*state.exp_phi)[i]);
             }
             // calculate logloss
-            prob = exp((*state.residual_std)[y_i][i]) / sum_fits; // logloss =  - log(p_j)
+            prob = (*state.exp_residual_std)[y_i][i] / sum_fits; // logloss =  - log(p_j)
 
             logloss += -log(prob);
         }
@@ -718,8 +924,10 @@ void LogitModel::calculateOtherSideSuffStat(std::vector<double> &parent_suff_sta
     return;
 }
 
-void LogitModel::state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const
+void LogitModel::state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const
 {
+    matrix<double> &residual_std = *state.residual_std;
+    matrix<double> &exp_residual_std = *state.exp_residual_std;
 
     size_t next_index = tree_ind + 1;
     if (next_index == M)
@@ -734,6 +942,7 @@ void LogitModel::state_sweep(size_t tree_ind, size_t M, matrix<double> &residual
         for (size_t j = 0; j < dim_theta; ++j)
         {
             residual_std[j][i] = residual_std[j][i] - log((*(x_struct.data_pointers[next_index][i]))[j]);
+            exp_residual_std[j][i] = exp_residual_std[j][i] / (*(x_struct.data_pointers[next_index][i]))[j];
             // residual_std[j][i] = residual_std[j][i] + log((*(x_struct.data_pointers[tree_ind][i]))[j]) - log((*(x_struct.data_pointers[next_index][i]))[j]);
         }
     }
@@ -781,7 +990,9 @@ void LogitModel::ini_residual_std(State &state)
         for (size_t j = 0; j < dim_theta; ++j)
         {
             (*state.residual_std)[j][i] = 0.0; // save resdiual_std as log(lamdas), start at 0.0.
+            (*state.exp_residual_std)[j][i] = 1.0;
         }
+        (*state.exp_phi)[i] = exp((*phi)[i]);
     }
     return;
 }
@@ -791,73 +1002,45 @@ void LogitModel::predict_std(const double *Xtestpointer, size_t N_test, size_t p
 
     // output is a 3D array (armadillo cube), nsweeps by n by number of categories
 
-    tree::tree_p bn;
+    // trees are compiled once with log of leaf parameters, so the leaf reached gives its log table row directly
+    // class scores of one observation and sweep are accumulated in log_prob, normalized, then copied to output
+    compiled_forest forest(trees);
+    forest.log_leaves();
 
-    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
-    {
+    std::vector<double> row(p);
+    std::vector<double> log_prob(dim_residual);
+    const double *log_theta_leaf;
 
-        for (size_t data_ind = 0; data_ind < N_test; data_ind++)
+    for (size_t data_ind = 0; data_ind < N_test; data_ind++)
+    {
+        for (size_t j = 0; j < p; j++)
         {
-
-            for (size_t i = 0; i < trees[0].size(); i++)
-            {
-                // search leaf
-                bn = trees[sweeps][i].search_bottom_std(Xtestpointer, data_ind, p, N_test);
-
-                for (size_t k = 0; k < dim_residual; k++)
-                {
-                    // add all trees
-
-                    // product of trees, thus sum of logs
-
-                    output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] += log(bn->theta_vector[k]);
-                }
-            }
+            row[j] = Xtestpointer[data_ind + j * N_test];
         }
-    }
-
-    // normalizing probability
-
-    double denom = 0.0;
-    double max_log_prob = -INFINITY;
 
-    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
-    {
-        for (size_t data_ind = 0; data_ind < N_test; data_ind++)
+        for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
         {
-
-            max_log_prob = -INFINITY;
-            // take exp, subtract max to avoid overflow
-
-            // this line does not work for some reason, havd to write loops manually
-            // output.tube(sweeps, data_ind) = exp(output.tube(sweeps, data_ind) - output.tube(sweeps, data_ind).max());
-
-            // find max of probability for all classes
             for (size_t k = 0; k < dim_residual; k++)
             {
-                if (output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] > max_log_prob)
-                {
-                    max_log_prob = output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
-                }
+                log_prob[k] = output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
             }
 
-            // take exp after subtracting max to avoid overflow
-            for (size_t k = 0; k < dim_residual; k++)
+            for (size_t i = 0; i < forest.num_trees; i++)
             {
-                output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] = exp(output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] - max_log_prob);
+                // product of trees, thus sum of logs
+                log_theta_leaf = forest.search_leaf(row.data(), sweeps, i);
+                for (size_t k = 0; k < dim_residual; k++)
+                {
+                    log_prob[k] += log_theta_leaf[k];
+                }
             }
 
-            // calculate normalizing constant
-            denom = 0.0;
-            for (size_t k = 0; k < dim_residual; k++)
-            {
-                denom += output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
-            }
+            // normalizing probability
+            log_sum_exp_normalize(&log_prob[0], dim_residual);
 
-            // normalizing
             for (size_t k = 0; k < dim_residual; k++)
             {
-                output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] = output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] / denom;
+                output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] = log_prob[k];
             }
         }
     }
@@ -993,12 +1176,13 @@ void LogitModelSeparateTrees::update_state(State &state, size_t tree_ind, X_stru
         y_i = (size_t)(*y_size_t)[i];
         for (size_t j = 0; j < dim_residual; ++j)
         {
-            sum_fits += exp((*state.residual_std)[j][i]) * (*(x_struct.data_pointers_multinomial[j][tree_ind][i]))[j]; // f_j(x_i) = \prod lambdas
+            sum_fits += (*state.exp_residual_std)[j][i] * (*(x_struct.data_pointers_multinomial[j][tree_ind][i]))[j]; // f_j(x_i) = \prod lambdas
         }
         // Sample phi
         (*phi)[i] = gammadist(state.gen) / (1.0 * sum_fits);
+        (*state.exp_phi)[i] = exp((*phi)[i]);
         // calculate logloss
-        logloss += -log(exp((*state.residual_std)[y_i][i]) * (*(x_struct.data_pointers_multinomial[y_i][tree_ind][i]))[y_i] / sum_fits); // logloss =  - log(p_j)
+        logloss += -log((*state.exp_residual_std)[y_i][i] * (*(x_struct.data_pointers_multinomial[y_i][tree_ind][i]))[y_i] / sum_fits); // logloss =  - log(p_j)
     }
 
     logloss = logloss / state.n_y;
@@ -1061,8 +1245,10 @@ void LogitModelSeparateTrees::update_state(State &state, size_t tree_ind, X_stru
     }
 }
 
-void LogitModelSeparateTrees::state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const
+void LogitModelSeparateTrees::state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const
 {
+    matrix<double> &residual_std = *state.residual_std;
+    matrix<double> &exp_residual_std = *state.exp_residual_std;
 
     size_t next_index = tree_ind + 1;
     if (next_index == M)
@@ -1077,6 +1263,7 @@ void LogitModelSeparateTrees::state_sweep(size_t tree_ind, size_t M, matrix<doub
         for (size_t j = 0; j < dim_theta; ++j)
         {
             residual_std[j][i] = residual_std[j][i] + log((*(x_struct.data_pointers_multinomial[j][tree_ind][i]))[j]) - log((*(x_struct.data_pointers_multinomial[j][next_index][i]))[j]);
+            exp_residual_std[j][i] = exp_residual_std[j][i] * (*(x_struct.data_pointers_multinomial[j][tree_ind][i]))[j] / (*(x_struct.data_pointers_multinomial[j][next_index][i]))[j];
         }
     }
 
@@ -1109,71 +1296,47 @@ void LogitModelSeparateTrees::predict_std(const double *Xtestpointer, size_t N_t
 
     // output is a 3D array (armadillo cube), nsweeps by n by number of categories
 
-    tree::tree_p bn;
-
-    for (size_t data_ind = 0; data_ind < N_test; data_ind++)
-    { // for each data observation
-
-        for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
-        {
-
-            for (size_t k = 0; k < dim_residual; k++)
-            { // loop over class
-
-                for (size_t i = 0; i < trees[0][0].size(); i++)
-                {
-                    bn = trees[k][sweeps][i].search_bottom_std(Xtestpointer, data_ind, p, N_test);
-
-                    // product of trees, thus sum of logs
-                    output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] += log(bn->theta_vector[k]);
-                }
-            }
-        }
+    // trees of each class are compiled once with log of leaf parameters, tree of class k contributes entry k of its leaf
+    // class scores of one observation and sweep are accumulated in log_prob, normalized, then copied to output
+    std::vector<compiled_forest> forests(dim_residual);
+    for (size_t k = 0; k < dim_residual; k++)
+    {
+        forests[k].compile(trees[k]);
+        forests[k].log_leaves();
     }
 
-    // normalizing probability
-
-    double denom = 0.0;
-    double max_log_prob = -INFINITY;
+    std::vector<double> row(p);
+    std::vector<double> log_prob(dim_residual);
 
-    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    for (size_t data_ind = 0; data_ind < N_test; data_ind++)
     {
-        for (size_t data_ind = 0; data_ind < N_test; data_ind++)
+        for (size_t j = 0; j < p; j++)
         {
+            row[j] = Xtestpointer[data_ind + j * N_test];
+        }
 
-            max_log_prob = -INFINITY;
-            // take exp, subtract max to avoid overflow
-
-            // this line does not work for some reason, havd to write loops manually
-            // output.tube(sweeps, data_ind) = exp(output.tube(sweeps, data_ind) - output.tube(sweeps, data_ind).max());
-
-            // find max of probability for all classes
+        for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+        {
             for (size_t k = 0; k < dim_residual; k++)
             {
-                if (output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] > max_log_prob)
-                {
-                    max_log_prob = output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
-                }
+                log_prob[k] = output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
             }
 
-            // take exp after subtracting max to avoid overflow
             for (size_t k = 0; k < dim_residual; k++)
-            {
-                output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] = exp(output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] - max_log_prob);
+            { // loop over class
+                for (size_t i = 0; i < forests[k].num_trees; i++)
+                {
+                    // product of trees, thus sum of logs
+                    log_prob[k] += forests[k].search_leaf(row.data(), sweeps, i)[k];
+                }
             }
 
-            // calculate normalizing constant
-            denom = 0.0;
-            for (size_t k = 0; k < dim_residual; k++)
-            {
-                // denom += output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
-                denom += output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test];
-            }
+            // normalizing probability
+            log_sum_exp_normalize(&log_prob[0], dim_residual);
 
-            // normalizing
             for (size_t k = 0; k < dim_residual; k++)
             {
-                output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] = output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] / denom;
+                output_vec[sweeps + data_ind * num_sweeps + k * num_sweeps * N_test] = log_prob[k];
             }
         }
     }
@@ -162,7 +162,7 @@ public:
 
     void calculateOtherSideSuffStat(std::vector<double> &parent_suff_stat, std::vector<double> &lchild_suff_stat, std::vector<double> &rchild_suff_stat, size_t &N_parent, size_t &N_left, size_t &N_right, bool &compute_left_side);
 
-    void state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const;
+    void state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const;
 
     double likelihood(std::vector<double> &temp_suff_stat, std::vector<double> &suff_stat_all, size_t N_left, bool left_side, bool no_split, State &state) const;
 
@@ -170,9 +170,16 @@ public:
 
     void ini_residual_std(State &state);
 
+    // warm start, initialize leaf pointers and residuals from one sweep of a saved forest
+    void copy_initialization(State &state, X_struct &x_struct, vector<tree> &warm_trees);
+
     void predict_std(const double *Xtestpointer, size_t N_test, size_t p, size_t num_trees, size_t num_sweeps, matrix<double> &yhats_test_xinfo, vector<vector<tree>> &trees);
 
     void predict_whole_std(const double *Xtestpointer, size_t N_test, size_t p, size_t num_trees, size_t num_sweeps, std::vector<double> &output_vec, vector<vector<tree>> &trees);
+
+    void predict_leaf_std(const std::vector<uint16_t> &leaf_index, matrix<double> &leaf_values, size_t N_test, size_t num_trees, size_t num_sweeps, matrix<double> &yhats_test_xinfo);
+
+    void predict_summary_std(const double *Xtestpointer, size_t N_test, size_t p, size_t num_trees, const std::vector<size_t> &sweeps_kept, const std::vector<double> &quantiles, std::vector<double> &mean_vec, std::vector<double> &var_vec, matrix<double> &quantile_xinfo, vector<vector<tree>> &trees);
 };
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -203,7 +210,15 @@ private:
             n = suffstats[j];
             sy = suffstats[dim_residual + j];
 
-            logz1 = loggignorm(-c + n, 2 * d, 2 * sy);
+            if (sy > 0)
+            {
+                // same as loggignorm(-c + n, 2 * d, 2 * sy), no scratch so concurrent split scans can share the model
+                logz1 = log(2) + lbk.evaluate(-c + n, sqrt(4 * d * sy)) - ((-c + n) / 2) * log(sy / d);
+            }
+            else
+            {
+                logz1 = loggignorm(-c + n, 2 * d, 2 * sy, lbk);
+            }
             logz2 = loggignorm(c + n, 0, 2 * (d + sy));
 
             logminz = logz1 < logz2 ? logz1 : logz2;
@@ -247,6 +262,8 @@ public:
 
     double c, d, z3, logz3; // param for mixture prior, c = m / tau_a^2 + 0.5; d = m / tau_a^2; m = num_trees = tau_b
 
+    log_bessel_k lbk; // log K_nu evaluator for orders -c + n, n = 0, 1, 2, ...
+
     double MH_step;
 
     LogitModel(size_t num_classes, double tau_a, double tau_b, double alpha, double beta, std::vector<size_t> *y_size_t, std::vector<double> *phi, double weight, bool update_weight, bool update_tau, bool update_phi, double hmult, double heps, double MH_step) : Model(num_classes, 2 * num_classes)
@@ -278,6 +295,7 @@ public:
         this->d = tau_b;
         this->z3 = exp(lgamma(this->c) - this->c * log(this->d));
         this->logz3 = lgamma(this->c) - this->c * log(this->d);
+        this->lbk = log_bessel_k(this->c);
         cout << "c = " << c << " d = " << d << " z3 = " << z3 << " logz3 " << logz3 << endl;
     }
 
@@ -303,7 +321,7 @@ public:
 
     void calculateOtherSideSuffStat(std::vector<double> &parent_suff_stat, std::vector<double> &lchild_suff_stat, std::vector<double> &rchild_suff_stat, size_t &N_parent, size_t &N_left, size_t &N_right, bool &compute_left_side);
 
-    void state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const;
+    void state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const;
 
     double likelihood(std::vector<double> &temp_suff_stat, std::vector<double> &suff_stat_all, size_t N_left, bool left_side, bool no_split, State &state) const;
 
@@ -356,7 +374,7 @@ public:
 
     void update_state(State &state, size_t tree_ind, X_struct &x_struct, double &mean_lambda, std::vector<double> &var_lambda, size_t &count_lambda);
 
-    void state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const;
+    void state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const;
 
     double likelihood(std::vector<double> &temp_suff_stat, std::vector<double> &suff_stat_all, size_t N_left, bool left_side, bool no_split, State &state) const;
 
@@ -553,6 +571,8 @@ public:
     void update_a(State &state);
 
     void update_b(State &state);
+
+    void update_full_residual_ss(State &state);
 };
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -679,7 +699,7 @@ public:
 
     double likelihood(std::vector<double> &temp_suff_stat, std::vector<double> &suff_stat_all, size_t N_left, bool left_side, bool no_split, State &state) const;
 
-    void state_sweep(size_t tree_ind, size_t M, matrix<double> &residual_std, X_struct &x_struct) const;
+    void state_sweep(size_t tree_ind, size_t M, State &state, X_struct &x_struct) const;
 
     void predict_std(const double *Xtestpointer, size_t N_test, size_t p, size_t num_trees, size_t num_sweeps, matrix<double> &yhats_test_xinfo, vector<vector<tree>> &trees);
 
@@ -57,14 +57,8 @@ void XBCFContinuousModel::samplePars(State &state, std::vector<double> &suff_sta
 void XBCFContinuousModel::update_state(State &state, size_t tree_ind, X_struct &x_struct)
 {
     // Draw Sigma
-    std::vector<double> full_residual(state.n_y);
-
-    for (size_t i = 0; i < state.n_y; i++)
-    {
-        full_residual[i] = (*state.y_std)[i] - (*state.mu_fit)[i] - ((*state.Z_std)[0][i]) * (*state.tau_fit)[i];
-    }
-
-    std::gamma_distribution<double> gamma_samp((state.n_y + kap) / 2.0, 2.0 / (sum_squared(full_residual) + s));
+    // sum of squared full residuals is maintained by ini_tau_mu_fit and add_new_tree_fit
+    std::gamma_distribution<double> gamma_samp((state.n_y + kap) / 2.0, 2.0 / (state.full_residual_ss + s));
     state.update_sigma(1.0 / sqrt(gamma_samp(state.gen)));
 
     return;
@@ -291,10 +285,12 @@ void XBCFContinuousModel::predict_std(matrix<double> &Ztestpointer, const double
 void XBCFContinuousModel::ini_tau_mu_fit(State &state)
 {
     double value = state.ini_var_yhat;
+    state.full_residual_ss = 0.0;
     for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
     {
         (*state.mu_fit)[i] = 0;
         (*state.tau_fit)[i] = value;
+        state.full_residual_ss += pow((*state.y_std)[i] - ((*state.Z_std)[0][i]) * value, 2);
     }
     return;
 }
@@ -351,12 +347,14 @@ void XBCFContinuousModel::subtract_old_tree_fit(size_t tree_ind, State &state, X
 
 void XBCFContinuousModel::add_new_tree_fit(size_t tree_ind, State &state, X_struct &x_struct)
 {
-
+    // also updates the sum of squared full residuals y - mu - Z * tau for the next sigma draw
+    state.full_residual_ss = 0.0;
     if (state.treatment_flag)
     {
         for (size_t i = 0; i < (*state.tau_fit).size(); i++)
         {
             (*state.tau_fit)[i] += (*(x_struct.data_pointers[tree_ind][i]))[0];
+            state.full_residual_ss += pow((*state.y_std)[i] - (*state.mu_fit)[i] - ((*state.Z_std)[0][i]) * (*state.tau_fit)[i], 2);
         }
     }
     else
@@ -364,6 +362,7 @@ void XBCFContinuousModel::add_new_tree_fit(size_t tree_ind, State &state, X_stru
         for (size_t i = 0; i < (*state.mu_fit).size(); i++)
         {
             (*state.mu_fit)[i] += (*(x_struct.data_pointers[tree_ind][i]))[0];
+            state.full_residual_ss += pow((*state.y_std)[i] - (*state.mu_fit)[i] - ((*state.Z_std)[0][i]) * (*state.tau_fit)[i], 2);
         }
     }
     return;
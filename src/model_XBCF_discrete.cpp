@@ -12,38 +12,14 @@
 
 void XBCFDiscreteModel::incSuffStat(State &state, size_t index_next_obs, std::vector<double> &suffstats)
 {
-    if (state.treatment_flag)
-    {
-        // treatment forest
-        if ((*state.Z_std)[0][index_next_obs] == 1)
-        {
-            // if treated
-            suffstats[1] += ((*state.y_std)[index_next_obs] - state.a * (*state.mu_fit)[index_next_obs] - state.b_vec[1] * (*state.tau_fit)[index_next_obs]) / state.b_vec[1];
-            suffstats[3] += 1;
-        }
-        else
-        {
-            // if control group
-            suffstats[0] += ((*state.y_std)[index_next_obs] - state.a * (*state.mu_fit)[index_next_obs] - state.b_vec[0] * (*state.tau_fit)[index_next_obs]) / state.b_vec[0];
-            suffstats[2] += 1;
-        }
-    }
-    else
-    {
-        // prognostic forest
-        if ((*state.Z_std)[0][index_next_obs] == 1)
-        {
-            // if treated
-            suffstats[1] += ((*state.y_std)[index_next_obs] - state.a * (*state.mu_fit)[index_next_obs] - state.b_vec[1] * (*state.tau_fit)[index_next_obs]) / state.a;
-            suffstats[3] += 1;
-        }
-        else
-        {
-            // if control group
-            suffstats[0] += ((*state.y_std)[index_next_obs] - state.a * (*state.mu_fit)[index_next_obs] - state.b_vec[0] * (*state.tau_fit)[index_next_obs]) / state.a;
-            suffstats[2] += 1;
-        }
-    }
+    // residual_std holds the working residual (y - a * mu - b_z * tau) / scale, set by update_partial_residuals
+    // treated_mask selects the group, so both forests accumulate without branching
+    double z = state.treated_mask[index_next_obs];
+    double r = (*state.residual_std)[0][index_next_obs];
+    suffstats[0] += r - z * r;
+    suffstats[1] += z * r;
+    suffstats[2] += 1.0 - z;
+    suffstats[3] += z;
     return;
 }
 
@@ -98,32 +74,10 @@ void XBCFDiscreteModel::samplePars(State &state, std::vector<double> &suff_stat,
 void XBCFDiscreteModel::update_state(State &state, size_t tree_ind, X_struct &x_struct, size_t ind)
 {
     // Draw Sigma
-    std::vector<double> full_residual_trt(state.N_trt);
-    std::vector<double> full_residual_ctrl(state.N_ctrl);
-
-    // index
-    size_t index_trt = 0;
-    size_t index_ctrl = 0;
-
-    for (size_t i = 0; i < state.n_y; i++)
-    {
-        if ((*state.Z_std)[0][i] == 1)
-        {
-            // if treated
-            full_residual_trt[index_trt] = (*state.y_std)[i] - state.a * (*state.mu_fit)[i] - state.b_vec[1] * (*state.tau_fit)[i];
-            index_trt++;
-        }
-        else
-        {
-            // if control group
-            full_residual_ctrl[index_ctrl] = (*state.y_std)[i] - state.a * (*state.mu_fit)[i] - state.b_vec[0] * (*state.tau_fit)[i];
-            index_ctrl++;
-        }
-    }
-
-    std::gamma_distribution<double> gamma_samp1((state.N_trt + kap) / 2.0, 2.0 / (sum_squared(full_residual_trt) + s));
+    // sums of squared full residuals per group are maintained by ini_tau_mu_fit, add_new_tree_fit, update_a and update_b
+    std::gamma_distribution<double> gamma_samp1((state.N_trt + kap) / 2.0, 2.0 / (state.full_residual_ss_vec[1] + s));
 
-    std::gamma_distribution<double> gamma_samp0((state.N_ctrl + kap) / 2.0, 2.0 / (sum_squared(full_residual_ctrl) + s));
+    std::gamma_distribution<double> gamma_samp0((state.N_ctrl + kap) / 2.0, 2.0 / (state.full_residual_ss_vec[0] + s));
 
     double sigma;
 
@@ -292,12 +246,11 @@ double XBCFDiscreteModel::likelihood(std::vector<double> &temp_suff_stat, std::v
 void XBCFDiscreteModel::ini_residual_std(State &state)
 {
     // initialize the vector of full residuals
-    double b_value;
+    size_t z;
     for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
     {
-        b_value = ((*state.Z_std)[0][i] == 1) ? state.b_vec[1] : state.b_vec[0];
-
-        (*state.residual_std)[0][i] = (*state.y_std)[i] - (state.a) * (*state.mu_fit)[i] - b_value * (*state.tau_fit)[i];
+        z = (size_t)state.treated_mask[i];
+        (*state.residual_std)[0][i] = (*state.y_std)[i] - (state.a) * (*state.mu_fit)[i] - state.b_vec[z] * (*state.tau_fit)[i];
     }
     return;
 }
@@ -354,6 +307,20 @@ void XBCFDiscreteModel::ini_tau_mu_fit(State &state)
         (*state.mu_fit)[i] = 0;
         (*state.tau_fit)[i] = value;
     }
+    update_full_residual_ss(state);
+    return;
+}
+
+void XBCFDiscreteModel::update_full_residual_ss(State &state)
+{
+    // sum of squared full residuals y - a * mu - b_z * tau, per group
+    std::fill(state.full_residual_ss_vec.begin(), state.full_residual_ss_vec.end(), 0.0);
+    size_t z;
+    for (size_t i = 0; i < state.n_y; i++)
+    {
+        z = (size_t)state.treated_mask[i];
+        state.full_residual_ss_vec[z] += pow((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - state.b_vec[z] * (*state.tau_fit)[i], 2);
+    }
     return;
 }
 
@@ -409,12 +376,16 @@ void XBCFDiscreteModel::subtract_old_tree_fit(size_t tree_ind, State &state, X_s
 
 void XBCFDiscreteModel::add_new_tree_fit(size_t tree_ind, State &state, X_struct &x_struct)
 {
-
+    // also updates the sums of squared full residuals for the next sigma draw
+    std::fill(state.full_residual_ss_vec.begin(), state.full_residual_ss_vec.end(), 0.0);
+    size_t z;
     if (state.treatment_flag)
     {
         for (size_t i = 0; i < (*state.tau_fit).size(); i++)
         {
             (*state.tau_fit)[i] += (*(x_struct.data_pointers[tree_ind][i]))[0];
+            z = (size_t)state.treated_mask[i];
+            state.full_residual_ss_vec[z] += pow((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - state.b_vec[z] * (*state.tau_fit)[i], 2);
         }
     }
     else
@@ -422,6 +393,8 @@ void XBCFDiscreteModel::add_new_tree_fit(size_t tree_ind, State &state, X_struct
         for (size_t i = 0; i < (*state.mu_fit).size(); i++)
         {
             (*state.mu_fit)[i] += (*(x_struct.data_pointers[tree_ind][i]))[0];
+            z = (size_t)state.treated_mask[i];
+            state.full_residual_ss_vec[z] += pow((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - state.b_vec[z] * (*state.tau_fit)[i], 2);
         }
     }
     return;
@@ -429,37 +402,26 @@ void XBCFDiscreteModel::add_new_tree_fit(size_t tree_ind, State &state, X_struct
 
 void XBCFDiscreteModel::update_partial_residuals(size_t tree_ind, State &state, X_struct &x_struct)
 {
+    // treatment forest: (y - a * mu - b * tau) / b
+    // prognostic forest: (y - a * mu - b * tau) / a
+    // the treated mask is fixed when the state is constructed, Z never changes
+    std::vector<double> &residual = (*state.residual_std)[0];
+    double scale[2];
     if (state.treatment_flag)
     {
-        // treatment forest
-        // (y - a * mu - b * tau) / b
-        for (size_t i = 0; i < (*state.tau_fit).size(); i++)
-        {
-            if ((*state.Z_std)[0][i] == 1)
-            {
-                ((*state.residual_std))[0][i] = ((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - (state.b_vec[1]) * (*state.tau_fit)[i]) / (state.b_vec[1]);
-            }
-            else
-            {
-                ((*state.residual_std))[0][i] = ((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - (state.b_vec[0]) * (*state.tau_fit)[i]) / (state.b_vec[0]);
-            }
-        }
+        scale[0] = state.b_vec[0];
+        scale[1] = state.b_vec[1];
     }
     else
     {
-        // prognostic forest
-        // (y - a * mu - b * tau) / a
-        for (size_t i = 0; i < (*state.tau_fit).size(); i++)
-        {
-            if ((*state.Z_std)[0][i] == 1)
-            {
-                ((*state.residual_std))[0][i] = ((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - (state.b_vec[1]) * (*state.tau_fit)[i]) / (state.a);
-            }
-            else
-            {
-                ((*state.residual_std))[0][i] = ((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - (state.b_vec[0]) * (*state.tau_fit)[i]) / (state.a);
-            }
-        }
+        scale[0] = state.a;
+        scale[1] = state.a;
+    }
+    size_t z;
+    for (size_t i = 0; i < (*state.tau_fit).size(); i++)
+    {
+        z = (size_t)state.treated_mask[i];
+        residual[i] = ((*state.y_std)[i] - state.a * (*state.mu_fit)[i] - state.b_vec[z] * (*state.tau_fit)[i]) / scale[z];
     }
     return;
 }
@@ -485,47 +447,35 @@ void XBCFDiscreteModel::update_a(State &state)
 
     std::normal_distribution<double> normal_samp(0.0, 1.0);
 
-    double mu2sum_ctrl = 0;
-    double mu2sum_trt = 0;
-    double muressum_ctrl = 0;
-    double muressum_trt = 0;
+    // sums per group, index 0 control and 1 treated
+    double mu2sum[2] = {0.0, 0.0};
+    double muressum[2] = {0.0, 0.0};
+    double res2sum[2] = {0.0, 0.0};
 
     // compute the residual y - b * tau(x)
-
+    size_t z;
     for (size_t i = 0; i < state.n_y; i++)
     {
-        if ((*state.Z_std)[0][i] == 1)
-        {
-            // if treated
-            (*state.residual_std)[0][i] = (*state.y_std)[i] - (*state.tau_fit)[i] * state.b_vec[1];
-        }
-        else
-        {
-            (*state.residual_std)[0][i] = (*state.y_std)[i] - (*state.tau_fit)[i] * state.b_vec[0];
-        }
-    }
-    for (size_t i = 0; i < state.n_y; i++)
-    {
-        if ((*state.Z_std)[0][i] == 1)
-        {
-            // if treated
-            mu2sum_trt += pow((*state.mu_fit)[i], 2);
-            muressum_trt += (*state.mu_fit)[i] * (*state.residual_std)[0][i];
-        }
-        else
-        {
-            mu2sum_ctrl += pow((*state.mu_fit)[i], 2);
-            muressum_ctrl += (*state.mu_fit)[i] * (*state.residual_std)[0][i];
-        }
+        z = (size_t)state.treated_mask[i];
+        (*state.residual_std)[0][i] = (*state.y_std)[i] - (*state.tau_fit)[i] * state.b_vec[z];
+        mu2sum[z] += pow((*state.mu_fit)[i], 2);
+        muressum[z] += (*state.mu_fit)[i] * (*state.residual_std)[0][i];
+        res2sum[z] += pow((*state.residual_std)[0][i], 2);
     }
     // update parameters
-    double v0 = 1.0 / (1.0 + mu2sum_ctrl / pow(state.sigma_vec[0], 2));
-    double m0 = v0 * (muressum_ctrl) / pow(state.sigma_vec[0], 2);
-    double v1 = 1 / (1.0 / v0 + mu2sum_trt / pow(state.sigma_vec[1], 2));
-    double m1 = v1 * (m0 / v0 + (muressum_trt) / pow(state.sigma_vec[1], 2));
+    double v0 = 1.0 / (1.0 + mu2sum[0] / pow(state.sigma_vec[0], 2));
+    double m0 = v0 * (muressum[0]) / pow(state.sigma_vec[0], 2);
+    double v1 = 1 / (1.0 / v0 + mu2sum[1] / pow(state.sigma_vec[1], 2));
+    double m1 = v1 * (m0 / v0 + (muressum[1]) / pow(state.sigma_vec[1], 2));
 
     state.a = m1 + sqrt(v1) * normal_samp(state.gen);
 
+    // sum of (r - a * mu)^2 per group, expanded in the sums above
+    for (z = 0; z < 2; z++)
+    {
+        state.full_residual_ss_vec[z] = res2sum[z] - 2 * state.a * muressum[z] + pow(state.a, 2) * mu2sum[z];
+    }
+
     return;
 }
 
@@ -535,37 +485,28 @@ void XBCFDiscreteModel::update_b(State &state)
 
     std::normal_distribution<double> normal_samp(0.0, 1.0);
 
-    double tau2sum_ctrl = 0;
-    double tau2sum_trt = 0;
-    double tauressum_ctrl = 0;
-    double tauressum_trt = 0;
+    // sums per group, index 0 control and 1 treated
+    double tau2sum[2] = {0.0, 0.0};
+    double tauressum[2] = {0.0, 0.0};
+    double res2sum[2] = {0.0, 0.0};
 
     // compute the residual y-a*mu(x) using state's objects y_std, mu_fit and a
+    size_t z;
     for (size_t i = 0; i < state.n_y; i++)
     {
+        z = (size_t)state.treated_mask[i];
         (*state.residual_std)[0][i] = (*state.y_std)[i] - state.a * (*state.mu_fit)[i];
-    }
-
-    for (size_t i = 0; i < state.n_y; i++)
-    {
-        if ((*state.Z_std)[0][i] == 1)
-        {
-            tau2sum_trt += pow((*state.tau_fit)[i], 2);
-            tauressum_trt += (*state.tau_fit)[i] * (*state.residual_std)[0][i];
-        }
-        else
-        {
-            tau2sum_ctrl += pow((*state.tau_fit)[i], 2);
-            tauressum_ctrl += (*state.tau_fit)[i] * (*state.residual_std)[0][i];
-        }
+        tau2sum[z] += pow((*state.tau_fit)[i], 2);
+        tauressum[z] += (*state.tau_fit)[i] * (*state.residual_std)[0][i];
+        res2sum[z] += pow((*state.residual_std)[0][i], 2);
     }
 
     // update parameters
-    double v0 = 1.0 / (2.0 + tau2sum_ctrl / pow(state.sigma_vec[0], 2));
-    double v1 = 1.0 / (2.0 + tau2sum_trt / pow(state.sigma_vec[1], 2));
+    double v0 = 1.0 / (2.0 + tau2sum[0] / pow(state.sigma_vec[0], 2));
+    double v1 = 1.0 / (2.0 + tau2sum[1] / pow(state.sigma_vec[1], 2));
 
-    double m0 = v0 * (tauressum_ctrl) / pow(state.sigma_vec[0], 2);
-    double m1 = v1 * (tauressum_trt) / pow(state.sigma_vec[1], 2);
+    double m0 = v0 * (tauressum[0]) / pow(state.sigma_vec[0], 2);
+    double m1 = v1 * (tauressum[1]) / pow(state.sigma_vec[1], 2);
 
     // sample b0, b1
     double b0 = m0 + sqrt(v0) * normal_samp(state.gen);
@@ -574,6 +515,12 @@ void XBCFDiscreteModel::update_b(State &state)
     state.b_vec[1] = b1;
     state.b_vec[0] = b0;
 
+    // sum of (r - b_z * tau)^2 per group, expanded in the sums above
+    for (z = 0; z < 2; z++)
+    {
+        state.full_residual_ss_vec[z] = res2sum[z] - 2 * state.b_vec[z] * tauressum[z] + pow(state.b_vec[z], 2) * tau2sum[z];
+    }
+
     return;
 }
  
\ No newline at end of file
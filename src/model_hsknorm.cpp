@@ -82,12 +82,37 @@ void hskNormalModel::state_sweep(size_t tree_ind, size_t M, State &state, X_stru
         next_index = 0;
     }
 
-    for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
+    std::vector<double> &residual_std = (*state.residual_std)[0];
+    std::vector<double> &precision = (*state.precision);
+    std::vector<double> &res_x_precision = (*state.res_x_precision);
+    std::vector<std::vector<double> *> &fit_current = x_struct.data_pointers[tree_ind];
+    std::vector<std::vector<double> *> &fit_next = x_struct.data_pointers[next_index];
+
+    // blocks of observations run on the thread pool
+    const size_t block_size = 8192;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+
+    auto sweep_block = [&](size_t block)
     {
-        (*state.residual_std)[0][i] = (*state.residual_std)[0][i] - (*(x_struct.data_pointers[tree_ind][i]))[0] + (*(x_struct.data_pointers[next_index][i]))[0];
-//        (*state.residual_std)[2][i] = (*state.residual_std)[0][i] * (*state.residual_std)[1][i];
-        (*state.res_x_precision)[i] = (*state.residual_std)[0][i] * (*state.precision)[i];
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+        for (size_t i = begin; i < end; i++)
+        {
+            residual_std[i] = residual_std[i] - (*fit_current[i])[0] + (*fit_next[i])[0];
+            res_x_precision[i] = residual_std[i] * precision[i];
+        }
+    };
+
+    bool parallel_sweep = thread_pool.is_active() && state.parallel && n_blocks > 1;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (parallel_sweep)
+            thread_pool.add_task(sweep_block, block);
+        else
+            sweep_block(block);
     }
+    if (parallel_sweep)
+        thread_pool.wait();
     return;
 }
 
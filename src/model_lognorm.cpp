@@ -23,10 +23,35 @@ void logNormalModel::ini_residual_std(State &state, matrix<double> &mean_residua
 void logNormalModel::ini_residual_std2(State &state, X_struct &x_struct)
 {
     // initialize partial residual at the residual^2 from the mean model
-    for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
+    // log_precision starts as the log precision without the first tree and is carried through state_sweep
+    std::vector<double> &residual_std = (*state.residual_std)[0];
+    std::vector<double> &log_precision = (*state.log_precision);
+    std::vector<std::vector<double> *> &fit_first = x_struct.data_pointers[0];
+
+    const size_t block_size = 8192;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+
+    auto ini_block = [&](size_t block)
     {
-        (*state.residual_std)[0][i] = 2*log(abs((*state.mean_res)[i])) + log((*state.precision)[i]) - log((*(x_struct.data_pointers[0][i]))[0]);
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+        for (size_t i = begin; i < end; i++)
+        {
+            log_precision[i] = log((*state.precision)[i]) - log((*fit_first[i])[0]);
+            residual_std[i] = 2 * log(abs((*state.mean_res)[i])) + log_precision[i];
+        }
+    };
+
+    bool parallel_ini = thread_pool.is_active() && state.parallel && n_blocks > 1;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (parallel_ini)
+            thread_pool.add_task(ini_block, block);
+        else
+            ini_block(block);
     }
+    if (parallel_ini)
+        thread_pool.wait();
     return;
 }
 
@@ -119,8 +144,7 @@ double logNormalModel::likelihood(std::vector<double> &temp_suff_stat,
 
 void logNormalModel::state_sweep(size_t tree_ind,
                                  size_t M,
-                                 matrix<double> &residual_std,
-                                 //std::vector<double> &fit,
+                                 State &state,
                                  X_struct &x_struct) const
 {
     size_t next_index = tree_ind + 1;
@@ -129,10 +153,38 @@ void logNormalModel::state_sweep(size_t tree_ind,
         next_index = 0;
     }
 
-    for (size_t i = 0; i < residual_std[0].size(); i++)
+    // the residual and the log precision take the same update, swapping the next tree for the current one
+    std::vector<double> &residual_std = (*state.residual_std)[0];
+    std::vector<double> &log_precision = (*state.log_precision);
+    std::vector<std::vector<double> *> &fit_current = x_struct.data_pointers[tree_ind];
+    std::vector<std::vector<double> *> &fit_next = x_struct.data_pointers[next_index];
+
+    const size_t block_size = 8192;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+
+    auto sweep_block = [&](size_t block)
     {
-        residual_std[0][i] = residual_std[0][i] + log((*(x_struct.data_pointers[tree_ind][i]))[0]) - log((*(x_struct.data_pointers[next_index][i]))[0]);
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+        double delta;
+        for (size_t i = begin; i < end; i++)
+        {
+            delta = log((*fit_current[i])[0]) - log((*fit_next[i])[0]);
+            residual_std[i] += delta;
+            log_precision[i] += delta;
+        }
+    };
+
+    bool parallel_sweep = thread_pool.is_active() && state.parallel && n_blocks > 1;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (parallel_sweep)
+            thread_pool.add_task(sweep_block, block);
+        else
+            sweep_block(block);
     }
+    if (parallel_sweep)
+        thread_pool.wait();
     return;
 }
 
@@ -166,17 +218,36 @@ void logNormalModel::update_state(State &state,
                                   size_t tree_ind,
                                   X_struct &x_struct)
 {
-    for (size_t i = 0; i < (*state.residual_std)[0].size(); i++)
+    // called after the last variance tree, state_sweep has left log_precision holding every tree but the first
+    // so the precision only needs the first tree added back instead of a product over the whole forest
+    std::vector<double> &log_precision = (*state.log_precision);
+    std::vector<std::vector<double> *> &fit_first = x_struct.data_pointers[0];
+
+    const size_t block_size = 8192;
+    size_t n_blocks = (state.n_y + block_size - 1) / block_size;
+
+    auto update_block = [&](size_t block)
     {
-        double log_sigma2 = 0;
-        for (size_t j = 0; j < tree_ind; j++)
+        size_t begin = block * block_size;
+        size_t end = std::min(begin + block_size, state.n_y);
+        for (size_t i = begin; i < end; i++)
         {
-            log_sigma2 += log((*(x_struct.data_pointers[j][i]))[0]);
+            (*state.precision)[i] = exp(log_precision[i]) * (*fit_first[i])[0];
+            (*state.residual_std)[0][i] = (*state.mean_res)[i];
+            (*state.res_x_precision)[i] = (*state.residual_std)[0][i] * (*state.precision)[i];
         }
-        (*state.precision)[i] = exp(log_sigma2);
-        (*state.residual_std)[0][i] = (*state.mean_res)[i];
-        (*state.res_x_precision)[i] = (*state.residual_std)[0][i] * (*state.precision)[i];
+    };
+
+    bool parallel_update = thread_pool.is_active() && state.parallel && n_blocks > 1;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        if (parallel_update)
+            thread_pool.add_task(update_block, block);
+        else
+            update_block(block);
     }
+    if (parallel_update)
+        thread_pool.wait();
     return;
 }
 
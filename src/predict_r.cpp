@@ -11,6 +11,7 @@
 #include "utility.h"
 #include "json_io.h"
 #include "utility_rcpp.h"
+#include "gp_predict.h"
 
 using namespace arma;
 
@@ -256,54 +257,238 @@ Rcpp::List xbart_predict_full(mat X, double y_mean, Rcpp::XPtr<std::vector<std::
 }
 
 // [[Rcpp::export]]
-Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt, Rcpp::NumericVector resid, mat sigma, double theta, double tau, size_t p_categorical = 0)
+Rcpp::List xbart_predict_summary(mat X, double y_mean, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt, Rcpp::IntegerVector sweeps, std::vector<double> quantiles)
 {
-    // should be able to run in parallel
-    COUT << "predict with gaussian process" << endl;
+    // posterior summary of XBART normal regression predictions, without storing all sweeps
+    // sweeps are the (1-based) stacked sweeps to summarize, the R side drops the burnin of every chain
 
     // Size of data
     size_t N = X.n_rows;
     size_t p = X.n_cols;
-    size_t N_test = Xtest.n_rows;
-    // number of continuous variables
-    size_t p_continuous = p - p_categorical; // only work for continuous for now
 
-    matrix<size_t> Xorder_std;
-    ini_matrix(Xorder_std, N, p);
+    // Init X_std matrix
+    Rcpp::NumericMatrix X_std(N, p);
+    for (size_t i = 0; i < N; i++)
+    {
+        for (size_t j = 0; j < p; j++)
+        {
+            X_std(i, j) = X(i, j);
+        }
+    }
+    double *Xpointer = &X_std[0];
+
+    // Trees
+    std::vector<std::vector<tree>> *trees = tree_pnt;
+
+    size_t N_sweeps = (*trees).size();
+    size_t M = (*trees)[0].size();
+
+    if (sweeps.size() == 0)
+    {
+        Rcpp::stop("no sweeps left after burnin");
+    }
+    std::vector<size_t> sweeps_kept(sweeps.size());
+    for (R_xlen_t k = 0; k < sweeps.size(); k++)
+    {
+        if (sweeps[k] == NA_INTEGER || sweeps[k] < 1 || (size_t)sweeps[k] > N_sweeps)
+        {
+            Rcpp::stop("sweeps must be between 1 and the number of sweeps");
+        }
+        sweeps_kept[k] = sweeps[k] - 1;
+    }
+    for (size_t k = 0; k < quantiles.size(); k++)
+    {
+        // also rejects NaN, vec_quantile indexes the sorted draws by (N - 1) * quantiles[k]
+        if (!(quantiles[k] >= 0.0 && quantiles[k] <= 1.0))
+        {
+            Rcpp::stop("quantiles must be probabilities between 0 and 1");
+        }
+    }
+
+    // Result Container
+    std::vector<double> mean_vec(N);
+    std::vector<double> var_vec(N);
+    matrix<double> quantile_xinfo;
+    ini_xinfo(quantile_xinfo, N, quantiles.size());
+
+    NormalModel *model = new NormalModel();
+
+    // Predict
+    model->predict_summary_std(Xpointer, N, p, M, sweeps_kept, quantiles, mean_vec, var_vec, quantile_xinfo, *trees);
+
+    delete model;
+
+    // Convert back to Rcpp
+    Rcpp::NumericMatrix yhats_quantile(N, quantiles.size());
+    for (size_t i = 0; i < N; i++)
+    {
+        for (size_t j = 0; j < quantiles.size(); j++)
+        {
+            yhats_quantile(i, j) = quantile_xinfo[j][i];
+        }
+    }
+
+    return Rcpp::List::create(Rcpp::Named("mean") = mean_vec, Rcpp::Named("var") = var_vec, Rcpp::Named("quantiles") = yhats_quantile);
+}
 
-    std::vector<double> y_std(N);
-    double y_mean = 0.0;
+// [[Rcpp::export]]
+Rcpp::List xbart_predict_leaf(mat X, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt)
+{
+    // index of leaf node reached by each testing observation in each tree of each sweep
+    // together with leaf parameters, so predictions can be recomputed without traversing trees
 
+    // Size of data
+    size_t N = X.n_rows;
+    size_t p = X.n_cols;
+
+    // Init X_std matrix
     Rcpp::NumericMatrix X_std(N, p);
-    Rcpp::NumericMatrix Xtest_std(N_test, p);
+    for (size_t i = 0; i < N; i++)
+    {
+        for (size_t j = 0; j < p; j++)
+        {
+            X_std(i, j) = X(i, j);
+        }
+    }
+    double *Xpointer = &X_std[0];
+
+    // Trees
+    std::vector<std::vector<tree>> *trees = tree_pnt;
 
-    rcpp_to_std2(y, X, Xtest, y_std, y_mean, X_std, Xtest_std, Xorder_std);
+    size_t N_sweeps = (*trees).size();
+    size_t M = (*trees)[0].size();
 
-    matrix<size_t> Xtestorder_std;
-    ini_matrix(Xtestorder_std, N_test, p);
+    std::vector<uint16_t> leaf_index(N * N_sweeps * M);
+    matrix<double> leaf_values;
 
-    // Create Xtestorder
-    umat Xtestorder(Xtest.n_rows, Xtest.n_cols);
-    for (size_t i = 0; i < Xtest.n_cols; i++)
+    getLeafIndex_Outsample(leaf_index, *trees, Xpointer, N, p);
+    getLeafValues(leaf_values, *trees);
+
+    size_t max_leaves = 0;
+    for (size_t i = 0; i < leaf_values.size(); i++)
     {
-        Xtestorder.col(i) = sort_index(Xtest.col(i));
+        max_leaves = std::max(max_leaves, leaf_values[i].size());
+    }
+
+    // Convert back to Rcpp, leaf index starts from 1 on the R side
+    Rcpp::IntegerVector leaf_index_rcpp(N * N_sweeps * M);
+    for (size_t i = 0; i < leaf_index.size(); i++)
+    {
+        leaf_index_rcpp[i] = (int)leaf_index[i] + 1;
+    }
+    leaf_index_rcpp.attr("dim") = Rcpp::Dimension(N, N_sweeps, M);
+
+    // unused entries of trees with less than max_leaves leaves are zero
+    Rcpp::NumericVector leaf_values_rcpp(max_leaves * N_sweeps * M);
+    for (size_t i = 0; i < leaf_values.size(); i++)
+    {
+        for (size_t j = 0; j < leaf_values[i].size(); j++)
+        {
+            leaf_values_rcpp[j + i * max_leaves] = leaf_values[i][j];
+        }
+    }
+    leaf_values_rcpp.attr("dim") = Rcpp::Dimension(max_leaves, N_sweeps, M);
+
+    return Rcpp::List::create(Rcpp::Named("leaf_index") = leaf_index_rcpp, Rcpp::Named("leaf_values") = leaf_values_rcpp);
+}
+
+// [[Rcpp::export]]
+Rcpp::List xbart_predict_from_leaf(Rcpp::IntegerVector leaf_index, Rcpp::NumericVector leaf_values, size_t N, size_t N_sweeps, size_t M, size_t max_leaves)
+{
+    // predict from the output of xbart_predict_leaf, leaf_values may be replaced by the user
+
+    if ((size_t)leaf_index.size() != N * N_sweeps * M || (size_t)leaf_values.size() != max_leaves * N_sweeps * M)
+    {
+        Rcpp::stop("leaf_index and leaf_values do not match the number of observations, sweeps and trees");
+    }
+    if (max_leaves > (size_t)UINT16_MAX + 1)
+    {
+        Rcpp::stop("number of leaves exceeds the range of leaf index");
+    }
+
+    std::vector<uint16_t> leaf_index_std(N * N_sweeps * M);
+    for (size_t i = 0; i < leaf_index_std.size(); i++)
+    {
+        // NA_INTEGER is negative and fails the check as well
+        if (leaf_index[i] < 1 || (size_t)leaf_index[i] > max_leaves)
+        {
+            Rcpp::stop("leaf index should be between 1 and the number of leaves");
+        }
+        leaf_index_std[i] = (uint16_t)(leaf_index[i] - 1);
+    }
+
+    matrix<double> leaf_values_std;
+    ini_matrix(leaf_values_std, max_leaves, N_sweeps * M);
+    for (size_t i = 0; i < N_sweeps * M; i++)
+    {
+        for (size_t j = 0; j < max_leaves; j++)
+        {
+            leaf_values_std[i][j] = leaf_values[j + i * max_leaves];
+        }
+    }
+
+    // Result Container
+    matrix<double> yhats_test_xinfo;
+    ini_xinfo(yhats_test_xinfo, N, N_sweeps);
+
+    NormalModel *model = new NormalModel();
+
+    // Predict
+    model->predict_leaf_std(leaf_index_std, leaf_values_std, N, M, N_sweeps, yhats_test_xinfo);
+
+    delete model;
+
+    // Convert back to Rcpp
+    Rcpp::NumericMatrix yhats(N, N_sweeps);
+    for (size_t i = 0; i < N; i++)
+    {
+        for (size_t j = 0; j < N_sweeps; j++)
+        {
+            yhats(i, j) = yhats_test_xinfo[j][i];
+        }
+    }
+
+    return Rcpp::List::create(Rcpp::Named("yhats") = yhats);
+}
+
+// [[Rcpp::export]]
+Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt, Rcpp::NumericVector resid, mat sigma, double theta, double tau, size_t p_categorical = 0, size_t max_train = 100, bool parallel = true, double nthread = 0)
+{
+    if (parallel)
+    {
+        thread_pool.start(nthread);
+    }
+
+    COUT << "predict with gaussian process" << endl;
+
+    // Size of data
+    size_t N = X.n_rows;
+    size_t p = X.n_cols;
+    size_t N_test = Xtest.n_rows;
+
+    // row major copies for leaf search
+    std::vector<double> X_row(N * p);
+    std::vector<double> Xtest_row(N_test * p);
+    for (size_t i = 0; i < N; i++)
+    {
+        for (size_t j = 0; j < p; j++)
+        {
+            X_row[i * p + j] = X(i, j);
+        }
     }
     for (size_t i = 0; i < N_test; i++)
     {
         for (size_t j = 0; j < p; j++)
         {
-            Xtestorder_std[j][i] = Xtestorder(i, j);
+            Xtest_row[i * p + j] = Xtest(i, j);
         }
     }
 
-    // double *ypointer = &y_std[0];
-    double *Xpointer = &X_std[0];
-    double *Xtestpointer = &Xtest_std[0];
-
     // Trees
     std::vector<std::vector<tree>> *trees = tree_pnt;
     size_t num_sweeps = (*trees).size();
     size_t num_trees = (*trees)[0].size();
+    compiled_forest forest(*trees);
 
     std::vector<double> sigma_std(num_sweeps);
     for (size_t i = 0; i < num_sweeps; i++)
@@ -311,14 +496,6 @@ Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vecto
         sigma_std[i] = sigma(i);
     }
 
-    // initialize X_struct
-    std::vector<double> initial_theta(1, y_mean / (double)num_trees);
-
-    gp_struct x_struct(Xpointer, &y_std, N, Xorder_std, p_categorical, p_continuous, &initial_theta, sigma_std, num_trees);
-    gp_struct xtest_struct(Xtestpointer, &y_std, N_test, Xtestorder_std, p_categorical, p_continuous, &initial_theta, sigma_std, num_trees);
-    x_struct.n_y = N;
-    xtest_struct.n_y = N_test;
-
     matrix<double> yhats_test_xinfo;
     ini_matrix(yhats_test_xinfo, N_test, num_sweeps);
     for (size_t i = 0; i < num_sweeps; i++)
@@ -326,9 +503,6 @@ Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vecto
         std::fill(yhats_test_xinfo[i].begin(), yhats_test_xinfo[i].end(), 0.0);
     }
 
-    std::vector<bool> active_var(p);
-    std::fill(active_var.begin(), active_var.end(), false);
-
     // get residuals
     matrix<std::vector<double>> residuals;
     ini_matrix(residuals, num_trees, num_sweeps);
@@ -343,22 +517,15 @@ Rcpp::List gp_predict(mat y, mat X, mat Xtest, Rcpp::XPtr<std::vector<std::vecto
             }
         }
     }
-    x_struct.set_resid(residuals);
 
-    // mcmc loop
-    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
-    {
-        for (size_t tree_ind = 0; tree_ind < num_trees; tree_ind++)
-        {
-            (*trees)[sweeps][tree_ind].gp_predict_from_root(Xorder_std, x_struct, x_struct.X_counts, x_struct.X_num_unique,
-                                                            Xtestorder_std, xtest_struct, xtest_struct.X_counts, xtest_struct.X_num_unique,
-                                                            yhats_test_xinfo, active_var, p_categorical, sweeps, tree_ind, theta, tau);
-        }
-    }
+    std::random_device rd;
+    gp_predict_forest(forest, &X_row[0], N, &Xtest_row[0], N_test, p, p_categorical, residuals, sigma_std, theta, tau, max_train, parallel, rd(), yhats_test_xinfo);
 
     Rcpp::NumericMatrix yhats_test(N_test, num_sweeps);
     Matrix_to_NumericMatrix(yhats_test_xinfo, yhats_test);
 
+    thread_pool.stop();
+
     return Rcpp::List::create(Rcpp::Named("yhats_test") = yhats_test);
 }
 
@@ -467,17 +634,33 @@ Rcpp::List json_to_r(Rcpp::StringVector json_string_r)
     // std::string json_string = json_string_r(0);
     json_string[0] = json_string_r(0);
     double y_mean;
+    std::vector<size_t> chain;
+    size_t p;
 
     // Create trees
     vector<vector<tree>> *trees2 = new std::vector<vector<tree>>();
 
     // Load
-    from_json_to_forest(json_string[0], *trees2, y_mean);
+    from_json_to_forest(json_string[0], *trees2, y_mean, chain, p);
 
     // Define External Pointer
     Rcpp::XPtr<std::vector<std::vector<tree>>> tree_pnt(trees2, true);
 
-    return Rcpp::List::create(Rcpp::Named("model_list") = Rcpp::List::create(Rcpp::Named("tree_pnt") = tree_pnt, Rcpp::Named("y_mean") = y_mean));
+    // chain of each sweep, 1 based as in the output of XBART
+    Rcpp::IntegerVector chain_index(chain.size());
+    for (size_t i = 0; i < chain.size(); i++)
+    {
+        chain_index(i) = chain[i] + 1;
+    }
+
+    // number of columns of the training data, left out for models saved without it
+    Rcpp::List model_list = Rcpp::List::create(Rcpp::Named("tree_pnt") = tree_pnt, Rcpp::Named("y_mean") = y_mean);
+    if (p > 0)
+    {
+        model_list["p"] = p;
+    }
+
+    return Rcpp::List::create(Rcpp::Named("model_list") = model_list, Rcpp::Named("chain") = chain_index);
 }
 
 // [[Rcpp::export]]
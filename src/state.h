@@ -18,8 +18,8 @@ public:
     matrix<size_t> *Xorder_std;
 
     // random number generators
+    // (no std::random_device member, so that State can be copied for per-task growth)
     std::vector<double> prob;
-    std::random_device rd;
     std::mt19937 gen;
     std::discrete_distribution<> d;
 
@@ -32,6 +32,19 @@ public:
     // mtry
     bool use_all = true;
     bool parallel = true;
+    double subsample = 1.0; // fraction of rows used to grow each tree, leaf parameters use all rows
+
+    // early stopping of sweeps, disabled if stop_tol is 0
+    double stop_tol = 0.0;
+    size_t stop_patience = 3;
+    size_t num_sweeps_run = 0; // number of sweeps actually run, set by the mcmc loop
+
+    // left child membership of observations at the split of the current node, filled by split_mask_std
+    std::vector<unsigned char> split_mask;
+
+    // number of nodes whose split search ran serially or on the thread pool
+    size_t nodes_serial = 0;
+    size_t nodes_parallel = 0;
 
     // fitinfo
     size_t n_min;
@@ -55,6 +68,8 @@ public:
     // residual standard deviation
     double sigma;
     double sigma2; // sigma squared
+    double full_residual_ss; // sum of squared full residuals, kept current by the model for the sigma draw
+    std::vector<double> root_suff_stat; // sufficient statistics at the root of the next tree, filled by the fused residual sweep
 
     // for heteroskedastic case
     // std::vector<double> sigma_vec; // residual standard deviation
@@ -66,6 +81,8 @@ public:
     // lambdas
     std::vector<std::vector<std::vector<double>>> *lambdas;
     std::vector<std::vector<std::vector<double>>> *lambdas_separate;
+    matrix<double> *exp_residual_std; // exp(residual_std), same class-major layout, kept in sync by the logit models
+    std::vector<double> *exp_phi;     // exp(phi) of the logit models
     size_t weight_exponent;
     double logloss_last_sweep;
 
@@ -81,6 +98,7 @@ public:
     std::vector<double> *mean_res; // temporary storage for mean model residual
     std::vector<double> *precision;
     std::vector<double> *res_x_precision;
+    std::vector<double> *log_precision; // sum of log variance-forest leaf values, excluding the tree being fitted
     size_t n_min_m;
     size_t n_min_v;
     size_t n_cutpoints_m;
@@ -122,6 +140,8 @@ public:
     // a is also used for logit model
     double a;                      // scaling parameter for mu               TODO: move to xbcfState
     std::vector<double> sigma_vec; // residual standard deviations           TODO: move to xbcfState
+    std::vector<double> full_residual_ss_vec; // sum of squared full residuals per group (control, treated)
+    std::vector<double> treated_mask;         // 1.0 for treated, 0.0 for control observations
     bool a_scaling;
     bool b_scaling;
     size_t N_trt;
@@ -153,6 +173,7 @@ public:
 
         // Random
         this->prob = std::vector<double>(2, 0.5);
+        std::random_device rd;
         this->gen = std::mt19937(rd());
         if (set_random_seed)
         {
@@ -258,6 +279,9 @@ public:
         this->lambdas_separate = new std::vector<std::vector<std::vector<double>>>();
         ini_lambda((*this->lambdas), num_trees, dim_residual);
         ini_lambda_separate((*this->lambdas_separate), num_trees, dim_residual);
+        this->exp_residual_std = new matrix<double>();
+        ini_matrix((*this->exp_residual_std), N, dim_residual);
+        this->exp_phi = new std::vector<double>(N, 1.0);
     }
 };
 
@@ -341,6 +365,12 @@ public:
         this->sigma_vec.resize(2);
         this->sigma_vec[0] = 1;
         this->sigma_vec[1] = 1;
+        this->full_residual_ss_vec.resize(2, 0.0);
+        this->treated_mask.resize(N, 0.0);
+        for (size_t i = 0; i < N; i++)
+        {
+            this->treated_mask[i] = ((*Z_std)[0][i] == 1) ? 1.0 : 0.0;
+        }
     }
 };
 
@@ -413,6 +443,7 @@ class HeteroskedasticState : public State
             this->mean_res = (new std::vector<double>(N, 0));
             this->precision = (new std::vector<double>(N, 1));
             this->res_x_precision = (new std::vector<double>(N, 0));
+            this->log_precision = (new std::vector<double>(N, 0));
             this->mtry = mtry;
             this->num_trees_m = num_trees_m;
             this->num_trees_v = num_trees_v;
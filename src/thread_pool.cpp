@@ -47,6 +47,41 @@ void ThreadPool::start(size_t nthreads)
                 }
             });
     }
+
+    calibrate();
+}
+
+void ThreadPool::calibrate()
+{
+    // scheduling cost, one round of a no-op task per thread and a wait
+    const size_t rounds = 16;
+    auto start_time = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+    {
+        for (size_t i = 0; i < threads.size(); i++)
+            add_task([]() {});
+        wait();
+    }
+    double round_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() / rounds;
+
+    // cost of one streamed row, a gather through a permuted index like the split search over Xorder
+    const size_t n = 1 << 16;
+    std::vector<double> values(n, 1.0);
+    std::vector<size_t> index(n);
+    std::iota(index.begin(), index.end(), 0);
+    std::shuffle(index.begin(), index.end(), std::mt19937(0));
+    volatile double sink = 0.0;
+    start_time = std::chrono::steady_clock::now();
+    double sum = 0.0;
+    for (size_t j = 0; j < n; j++)
+        sum += values[index[j]];
+    sink = sum;
+    (void)sink;
+    double row_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() / n;
+
+    // parallel work should take at least twice the scheduling cost
+    min_parallel_work = row_time > 0 ? (size_t)(2.0 * round_time / row_time) : 0;
+    min_parallel_work = std::min(std::max(min_parallel_work, (size_t)1000), (size_t)10000000);
 }
 
 void ThreadPool::wait()
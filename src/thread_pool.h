@@ -13,6 +13,10 @@
 #include <stdexcept>
 #include <thread>
 #include <vector>
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -109,7 +113,18 @@ public:
     // Are the worker threads running?
     inline bool is_active() { return !stopping && threads.size() > 0; }
 
+    // Number of worker threads
+    inline size_t num_threads() { return threads.size(); }
+
+    // Smallest amount of work, in streamed rows, worth a round of tasks on the pool
+    // Calibrated by start() against the cost of scheduling and waiting for one task per thread
+    inline size_t grain_size() { return min_parallel_work; }
+
 private:
+    void calibrate();
+
+    size_t min_parallel_work = 0;
+
     std::vector<std::thread> threads;
     std::queue<std::shared_ptr<ThreadPoolTaskStatus>> statuses;
     std::queue<std::function<void()>> tasks;
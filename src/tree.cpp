@@ -3,6 +3,7 @@
 //////////////////////////////////////////////////////////////////////////////////////
 
 #include "tree.h"
+#include "compiled_forest.h"
 #include <chrono>
 #include <ctime>
 using namespace std;
@@ -691,6 +692,8 @@ void tree::grow_from_root(State &state, matrix<size_t> &Xorder_std, std::vector<
     std::vector<size_t> X_counts_left(X_counts.size());
     std::vector<size_t> X_counts_right(X_counts.size());
 
+    split_mask_std(state, Xorder_std, split_var, split_point);
+
     if (state.p_categorical > 0)
     {
         split_xorder_std_categorical(Xorder_left_std, Xorder_right_std, split_var, split_point, Xorder_std, X_counts_left, X_counts_right, X_num_unique_left, X_num_unique_right, X_counts, model, x_struct, state, this);
@@ -723,7 +726,7 @@ void calculate_entropy(matrix<size_t> &Xorder_std, State &state, std::vector<dou
         next_obs = Xorder_std[0][i];
         for (size_t j = 0; j < dim_residual; ++j)
         {
-            fits[j] = exp((*state.residual_std)[j][next_obs]) * theta_vector[j]; // f_j(x_i) = \prod lambdas
+            fits[j] = (*state.exp_residual_std)[j][next_obs] * theta_vector[j]; // f_j(x_i) = \prod lambdas
         }
         sum_fits = accumulate(fits.begin(), fits.end(), 0.0);
         for (size_t j = 0; j < dim_residual; ++j)
@@ -887,6 +890,8 @@ void tree::grow_from_root_entropy(State &state, matrix<size_t> &Xorder_std, std:
     std::vector<size_t> X_counts_left(X_counts.size());
     std::vector<size_t> X_counts_right(X_counts.size());
 
+    split_mask_std(state, Xorder_std, split_var, split_point);
+
     if (state.p_categorical > 0)
     {
         split_xorder_std_categorical(Xorder_left_std, Xorder_right_std, split_var, split_point, Xorder_std, X_counts_left, X_counts_right, X_num_unique_left, X_num_unique_right, X_counts, model, x_struct, state, this);
@@ -1053,6 +1058,9 @@ void tree::grow_from_root_separate_tree(State &state, matrix<size_t> &Xorder_std
 
     std::vector<size_t> X_counts_left(X_counts.size());
     std::vector<size_t> X_counts_right(X_counts.size());
+
+    split_mask_std(state, Xorder_std, split_var, split_point);
+
     if (state.p_categorical > 0)
     {
         split_xorder_std_categorical(Xorder_left_std, Xorder_right_std, split_var, split_point, Xorder_std, X_counts_left, X_counts_right, X_num_unique_left, X_num_unique_right, X_counts, model, x_struct, state, this);
@@ -1070,6 +1078,33 @@ void tree::grow_from_root_separate_tree(State &state, matrix<size_t> &Xorder_std
     return;
 }
 
+void split_mask_std(State &state, matrix<size_t> &Xorder_std, size_t split_var, size_t split_point)
+{
+    // mark observations of the node that go to the left child, indexed by observation
+    // rows up to split_point in the order of the split variable go left, and so do later ties with the cutpoint
+    // the column partitions then read one byte per row instead of the split variable
+    const double *x = state.X_std + state.n_y * split_var;
+    std::vector<size_t> &xo = Xorder_std[split_var];
+    double cutvalue = x[xo[split_point]];
+    size_t N_Xorder = xo.size();
+
+    state.split_mask.resize(state.n_y);
+    size_t j = 0;
+    for (; j <= split_point; j++)
+    {
+        state.split_mask[xo[j]] = 1;
+    }
+    for (; j < N_Xorder && x[xo[j]] <= cutvalue; j++)
+    {
+        state.split_mask[xo[j]] = 1;
+    }
+    for (; j < N_Xorder; j++)
+    {
+        state.split_mask[xo[j]] = 0;
+    }
+    return;
+}
+
 void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t> &Xorder_right_std, size_t split_var, size_t split_point, matrix<size_t> &Xorder_std, Model *model, X_struct &x_struct, State &state, tree *current_node)
 {
 
@@ -1088,9 +1123,8 @@ void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t>
     current_node->l->ini_suff_stat();
     current_node->r->ini_suff_stat();
 
-    double cutvalue = *(state.X_std + state.n_y * split_var + Xorder_std[split_var][split_point]);
-
-    const double *temp_pointer = state.X_std + state.n_y * split_var;
+    // left child membership by observation, from split_mask_std
+    const std::vector<unsigned char> &go_left = state.split_mask;
 
     // TODO: this version yield negative suffstat on the other side sometime.
     // for (size_t j = 0; j < N_Xorder; j++)
@@ -1113,7 +1147,7 @@ void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t>
 
     for (size_t j = 0; j < N_Xorder; j++)
     {
-        if (*(temp_pointer + Xorder_std[split_var][j]) <= cutvalue)
+        if (go_left[Xorder_std[split_var][j]])
         {
             model->updateNodeSuffStat(state, current_node->l->suff_stat, Xorder_std, split_var, j);
         }
@@ -1123,7 +1157,7 @@ void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t>
         }
     }
 
-    const double *split_var_x_pointer = state.X_std + state.n_y * split_var;
+    bool parallel = parallel_node(state, N_Xorder, state.p_continuous);
 
     for (size_t i = 0; i < state.p_continuous; i++) // loop over variables
     {
@@ -1139,7 +1173,7 @@ void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t>
 
             for (size_t j = 0; j < N_Xorder; j++)
             {
-                if (*(split_var_x_pointer + xo[j]) <= cutvalue)
+                if (go_left[xo[j]])
                 {
                     xo_left[left_ix] = xo[j];
                     left_ix = left_ix + 1;
@@ -1152,7 +1186,7 @@ void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t>
             }
         };
 
-        if (thread_pool.is_active() && state.parallel)
+        if (parallel)
         {
             thread_pool.add_task(split_i);
         }
@@ -1162,7 +1196,7 @@ void split_xorder_std_continuous(matrix<size_t> &Xorder_left_std, matrix<size_t>
         }
     }
 
-    if (thread_pool.is_active())
+    if (parallel)
         thread_pool.wait();
 
     // model->calculateOtherSideSuffStat(current_node->suff_stat, current_node->l->suff_stat, current_node->r->suff_stat, N_Xorder, N_Xorder_left, N_Xorder_right, compute_left_side);
@@ -1179,7 +1213,8 @@ void split_xorder_std_categorical(matrix<size_t> &Xorder_left_std, matrix<size_t
     size_t N_Xorder = Xorder_std[0].size();
     size_t N_Xorder_left = Xorder_left_std[0].size();
     size_t N_Xorder_right = Xorder_right_std[0].size();
-    const double *temp_pointer = state.X_std + state.n_y * split_var;
+    // left child membership by observation, from split_mask_std
+    const std::vector<unsigned char> &go_left = state.split_mask;
 
     // if the left side is smaller, we only compute sum of it
     bool compute_left_side = N_Xorder_left < N_Xorder_right;
@@ -1192,117 +1227,132 @@ void split_xorder_std_categorical(matrix<size_t> &Xorder_left_std, matrix<size_t
     std::fill(X_num_unique_left.begin(), X_num_unique_left.end(), 0.0);
     std::fill(X_num_unique_right.begin(), X_num_unique_right.end(), 0.0);
 
+    // each variable writes its own Xorder columns and its own slices of X_counts_left, X_counts_right and X_num_unique
+    // only the split variable updates the sufficient statistics of the child nodes, so variables run as separate tasks
+    bool parallel = parallel_node(state, N_Xorder, state.p_categorical);
+
     for (size_t i = state.p_continuous; i < state.p; i++)
     {
         // loop over variables
-        size_t left_ix = 0;
-        size_t right_ix = 0;
+        auto split_i = [&, i]()
+        {
+            size_t left_ix = 0;
+            size_t right_ix = 0;
 
-        // index range of X_counts, X_values that are corresponding to current variable
-        // start <= i <= end;
-        size_t start = x_struct.variable_ind[i - state.p_continuous];
-        size_t end = x_struct.variable_ind[i + 1 - state.p_continuous];
+            // index range of X_counts, X_values that are corresponding to current variable
+            // start <= i <= end;
+            size_t start = x_struct.variable_ind[i - state.p_continuous];
+            size_t end = x_struct.variable_ind[i + 1 - state.p_continuous];
 
-        if (i == split_var)
-        {
-            if (compute_left_side)
+            if (i == split_var)
             {
-                for (size_t j = 0; j < N_Xorder; j++)
+                if (compute_left_side)
                 {
-                    if (*(temp_pointer + Xorder_std[i][j]) <= cutvalue)
+                    for (size_t j = 0; j < N_Xorder; j++)
                     {
-                        model->updateNodeSuffStat(state, current_node->l->suff_stat, Xorder_std, split_var, j);
-                        Xorder_left_std[i][left_ix] = Xorder_std[i][j];
-                        left_ix = left_ix + 1;
+                        if (go_left[Xorder_std[i][j]])
+                        {
+                            model->updateNodeSuffStat(state, current_node->l->suff_stat, Xorder_std, split_var, j);
+                            Xorder_left_std[i][left_ix] = Xorder_std[i][j];
+                            left_ix = left_ix + 1;
+                        }
+                        else
+                        {
+                            // go to right side
+                            model->updateNodeSuffStat(state, current_node->r->suff_stat, Xorder_std, split_var, j);
+                            Xorder_right_std[i][right_ix] = Xorder_std[i][j];
+                            right_ix = right_ix + 1;
+                        }
+                    }
+                }
+                else
+                {
+                    for (size_t j = 0; j < N_Xorder; j++)
+                    {
+                        if (go_left[Xorder_std[i][j]])
+                        {
+                            model->updateNodeSuffStat(state, current_node->l->suff_stat, Xorder_std, split_var, j);
+                            Xorder_left_std[i][left_ix] = Xorder_std[i][j];
+                            left_ix = left_ix + 1;
+                        }
+                        else
+                        {
+                            model->updateNodeSuffStat(state, current_node->r->suff_stat, Xorder_std, split_var, j);
+                            Xorder_right_std[i][right_ix] = Xorder_std[i][j];
+                            right_ix = right_ix + 1;
+                        }
+                    }
+                }
+
+                // for the cut variable, it's easy to counts X_counts_left and X_counts_right, simply cut X_counts to two pieces.
+
+                for (size_t k = start; k < end; k++)
+                {
+                    // loop from start to end!
+
+                    if (x_struct.X_values[k] <= cutvalue)
+                    {
+                        // smaller than cutvalue, go left
+                        X_counts_left[k] = X_counts[k];
                     }
                     else
                     {
-                        // go to right side
-                        model->updateNodeSuffStat(state, current_node->r->suff_stat, Xorder_std, split_var, j);
-                        Xorder_right_std[i][right_ix] = Xorder_std[i][j];
-                        right_ix = right_ix + 1;
+                        // otherwise go right
+                        X_counts_right[k] = X_counts[k];
                     }
                 }
             }
             else
             {
+                size_t X_counts_index = start;
+                // split other variables, need to compare each row
                 for (size_t j = 0; j < N_Xorder; j++)
                 {
-                    if (*(temp_pointer + Xorder_std[i][j]) <= cutvalue)
+                    while (*(state.X_std + state.n_y * i + Xorder_std[i][j]) != x_struct.X_values[X_counts_index])
+                    {
+                        //     // for the current observation, find location of corresponding unique values
+                        X_counts_index++;
+                    }
+
+                    if (go_left[Xorder_std[i][j]])
                     {
-                        model->updateNodeSuffStat(state, current_node->l->suff_stat, Xorder_std, split_var, j);
+                        // go to left side
                         Xorder_left_std[i][left_ix] = Xorder_std[i][j];
                         left_ix = left_ix + 1;
+                        X_counts_left[X_counts_index]++;
                     }
                     else
                     {
-                        model->updateNodeSuffStat(state, current_node->r->suff_stat, Xorder_std, split_var, j);
+                        // go to right side
                         Xorder_right_std[i][right_ix] = Xorder_std[i][j];
                         right_ix = right_ix + 1;
+                        X_counts_right[X_counts_index]++;
                     }
                 }
             }
 
-            // for the cut variable, it's easy to counts X_counts_left and X_counts_right, simply cut X_counts to two pieces.
-
-            for (size_t k = start; k < end; k++)
+            for (size_t j = start; j < end; j++)
             {
-                // loop from start to end!
-
-                if (x_struct.X_values[k] <= cutvalue)
+                if (X_counts_left[j] > 0)
                 {
-                    // smaller than cutvalue, go left
-                    X_counts_left[k] = X_counts[k];
+                    X_num_unique_left[i - state.p_continuous] = X_num_unique_left[i - state.p_continuous] + 1;
                 }
-                else
+                if (X_counts_right[j] > 0)
                 {
-                    // otherwise go right
-                    X_counts_right[k] = X_counts[k];
+                    X_num_unique_right[i - state.p_continuous] = X_num_unique_right[i - state.p_continuous] + 1;
                 }
             }
-        }
-        else
-        {
-            size_t X_counts_index = start;
-            // split other variables, need to compare each row
-            for (size_t j = 0; j < N_Xorder; j++)
-            {
-                while (*(state.X_std + state.n_y * i + Xorder_std[i][j]) != x_struct.X_values[X_counts_index])
-                {
-                    //     // for the current observation, find location of corresponding unique values
-                    X_counts_index++;
-                }
-
-                if (*(temp_pointer + Xorder_std[i][j]) <= cutvalue)
-                {
-                    // go to left side
-                    Xorder_left_std[i][left_ix] = Xorder_std[i][j];
-                    left_ix = left_ix + 1;
-                    X_counts_left[X_counts_index]++;
-                }
-                else
-                {
-                    // go to right side
-                    Xorder_right_std[i][right_ix] = Xorder_std[i][j];
-                    right_ix = right_ix + 1;
-                    X_counts_right[X_counts_index]++;
-                }
-            }
-        }
+        };
 
-        for (size_t j = start; j < end; j++)
-        {
-            if (X_counts_left[j] > 0)
-            {
-                X_num_unique_left[i - state.p_continuous] = X_num_unique_left[i - state.p_continuous] + 1;
-            }
-            if (X_counts_right[j] > 0)
-            {
-                X_num_unique_right[i - state.p_continuous] = X_num_unique_right[i - state.p_continuous] + 1;
-            }
-        }
+        if (parallel)
+            thread_pool.add_task(split_i);
+        else
+            split_i();
     }
 
+    if (parallel)
+        thread_pool.wait();
+
     // model->calculateOtherSideSuffStat(current_node->suff_stat, current_node->l->suff_stat, current_node->r->suff_stat, N_Xorder, N_Xorder_left, N_Xorder_right, compute_left_side);
 
     // update X_num_unique
@@ -1555,6 +1605,40 @@ void BART_likelihood_all(matrix<size_t> &Xorder_std, bool &no_split, size_t &spl
     return;
 }
 
+bool parallel_node(State &state, size_t N, size_t n_vars)
+{
+    // per variable tasks of a node go to the thread pool only if the work, N * n_vars streamed rows,
+    // covers the scheduling cost calibrated when the pool started
+    return thread_pool.is_active() && state.parallel && N * n_vars >= thread_pool.grain_size();
+}
+
+size_t split_search_blocks(State &state, size_t N, size_t n_vars)
+{
+    // cost model of the continuous split search at a node, in units of streamed rows
+    // feature parallel runs one task per variable, it takes ceil(n_vars / threads) passes over the node
+    // data parallel cuts the cutpoint segments of each variable into n_blocks row blocks,
+    // it takes ceil(n_vars * n_blocks / threads) passes over a block, plus a serial merge of the segment statistics
+    // and the scheduling cost per task calibrated when the pool started
+    // returns the number of blocks per variable, 1 for feature parallel
+    if (!(thread_pool.is_active() && state.parallel) || n_vars == 0)
+    {
+        return 1;
+    }
+
+    size_t threads = thread_pool.num_threads();
+    double task_overhead = thread_pool.grain_size() / (2.0 * threads);
+    size_t n_blocks = std::min((threads + n_vars - 1) / n_vars, state.n_cutpoints);
+    if (n_blocks <= 1)
+    {
+        return 1;
+    }
+
+    double cost_feature = (double)((n_vars + threads - 1) / threads) * N + n_vars * task_overhead;
+    double cost_data = (double)((n_vars * n_blocks + threads - 1) / threads) * N / n_blocks + (double)n_vars * state.n_cutpoints + n_vars * n_blocks * task_overhead;
+
+    return cost_data < cost_feature ? n_blocks : 1;
+}
+
 void calculate_loglikelihood_continuous(std::vector<double> &loglike, const std::vector<size_t> &subset_vars, size_t &N_Xorder, matrix<size_t> &Xorder_std, double &loglike_max, Model *model, X_struct &x_struct, State &state, tree *tree_pointer)
 {
     size_t N = N_Xorder;
@@ -1568,6 +1652,8 @@ void calculate_loglikelihood_continuous(std::vector<double> &loglike, const std:
         // is there any smarter way to do it?
         std::vector<size_t> candidate_index(1);
 
+        state.nodes_serial++;
+
         // set up parallel during burnin
         for (auto i : subset_vars)
         {
@@ -1597,38 +1683,101 @@ void calculate_loglikelihood_continuous(std::vector<double> &loglike, const std:
         std::vector<size_t> candidate_index2(state.n_cutpoints + 1);
         seq_gen_std2(state.n_min, N - state.n_min, state.n_cutpoints, candidate_index2);
 
+        std::vector<size_t> continuous_vars;
         for (auto &&i : subset_vars)
         {
             if (i < state.p_continuous)
             {
+                continuous_vars.push_back(i);
+            }
+        }
 
-                // Lambda callback to perform the calculation
-                auto calcllc_i = [&, i]()
-                {
-                    std::vector<size_t> &xorder = Xorder_std[i];
-                    // double llmax = -INFINITY;
+        bool parallel = parallel_node(state, N, continuous_vars.size());
+        state.nodes_parallel += parallel;
+        state.nodes_serial += !parallel;
 
-                    std::vector<double> temp_suff_stat(model->dim_suffstat);
+        size_t n_blocks = parallel ? split_search_blocks(state, N, continuous_vars.size()) : 1;
 
-                    std::fill(temp_suff_stat.begin(), temp_suff_stat.end(), 0.0);
+        // all paths use the same arithmetic, so the chosen split does not depend on nthread or the calibrated grain size
+        // the sufficient statistics of each cutpoint segment (rows candidate_index2[j] + 1 to candidate_index2[j + 1]) are summed from zero,
+        // prefix sums over the segments give the left side statistics at each cutpoint
+        size_t dim_suffstat = model->dim_suffstat;
 
-                    std::vector<double> &temp = loglike;
+        auto segment_sums = [&](size_t var_i, size_t begin, size_t end, double *segments)
+        {
+            std::vector<size_t> &xorder = Xorder_std[continuous_vars[var_i]];
+            std::vector<double> temp_suff_stat(dim_suffstat);
+            for (size_t j = begin; j < end; j++)
+            {
+                std::fill(temp_suff_stat.begin(), temp_suff_stat.end(), 0.0);
+                calcSuffStat_continuous(state, temp_suff_stat, xorder, candidate_index2, j, true, model, (*state.residual_std));
+                std::copy(temp_suff_stat.begin(), temp_suff_stat.end(), segments + j * dim_suffstat);
+            }
+        };
 
-                    for (size_t j = 0; j < state.n_cutpoints; j++)
-                    {
-                        calcSuffStat_continuous(state, temp_suff_stat, xorder, candidate_index2, j, true, model, (*state.residual_std));
+        auto cutpoint_loglike = [&](size_t var_i, const double *segments)
+        {
+            size_t i = continuous_vars[var_i];
+            std::vector<double> temp_suff_stat(dim_suffstat, 0.0);
+            for (size_t j = 0; j < state.n_cutpoints; j++)
+            {
+                for (size_t k = 0; k < dim_suffstat; k++)
+                {
+                    temp_suff_stat[k] += segments[j * dim_suffstat + k];
+                }
+                loglike[(state.n_cutpoints) * i + j] = model->likelihood(temp_suff_stat, tree_pointer->suff_stat, candidate_index2[j + 1], true, false, state) + model->likelihood(temp_suff_stat, tree_pointer->suff_stat, candidate_index2[j + 1], false, false, state);
+            }
+        };
 
-                        temp[(state.n_cutpoints) * i + j] = model->likelihood(temp_suff_stat, tree_pointer->suff_stat, candidate_index2[j + 1], true, false, state) + model->likelihood(temp_suff_stat, tree_pointer->suff_stat, candidate_index2[j + 1], false, false, state);
-                    }
-                };
+        if (n_blocks > 1)
+        {
+            // data parallel, few variables on a large node
+            // each task sums a block of cutpoint segments of one variable, then each variable's prefix sums and likelihoods are a task
+            matrix<double> segment_suff_stat;
+            ini_matrix(segment_suff_stat, state.n_cutpoints * dim_suffstat, continuous_vars.size());
 
-                if (thread_pool.is_active() && state.parallel)
-                    thread_pool.add_task(calcllc_i);
-                else
-                    calcllc_i();
+            auto calcllc_block = [&](size_t task)
+            {
+                size_t var_i = task / n_blocks;
+                size_t block = task % n_blocks;
+                segment_sums(var_i, block * state.n_cutpoints / n_blocks, (block + 1) * state.n_cutpoints / n_blocks, segment_suff_stat[var_i].data());
+            };
+
+            auto calcllc_var = [&](size_t var_i)
+            {
+                cutpoint_loglike(var_i, segment_suff_stat[var_i].data());
+            };
+
+            for (size_t task = 0; task < continuous_vars.size() * n_blocks; task++)
+            {
+                thread_pool.add_task(calcllc_block, task);
+            }
+            thread_pool.wait();
+
+            for (size_t var_i = 0; var_i < continuous_vars.size(); var_i++)
+            {
+                thread_pool.add_task(calcllc_var, var_i);
             }
+            thread_pool.wait();
+            return;
+        }
+
+        // feature parallel or serial, one variable at a time
+        auto calcllc_i = [&](size_t var_i)
+        {
+            std::vector<double> segments(state.n_cutpoints * dim_suffstat);
+            segment_sums(var_i, 0, state.n_cutpoints, segments.data());
+            cutpoint_loglike(var_i, segments.data());
+        };
+
+        for (size_t var_i = 0; var_i < continuous_vars.size(); var_i++)
+        {
+            if (parallel)
+                thread_pool.add_task(calcllc_i, var_i);
+            else
+                calcllc_i(var_i);
         }
-        if (thread_pool.is_active())
+        if (parallel)
             thread_pool.wait();
     }
 }
@@ -1638,6 +1787,19 @@ void calculate_loglikelihood_categorical(std::vector<double> &loglike, size_t &l
 
     // loglike_start is an index to offset
     // consider loglikelihood start from loglike_start
+    // each variable writes its own slice of loglike, so variables run as separate tasks
+    size_t n_vars = 0;
+    for (auto &&i : subset_vars)
+    {
+        n_vars += (i >= state.p_continuous);
+    }
+    bool parallel = parallel_node(state, N_Xorder, n_vars);
+    if (state.p_continuous == 0)
+    {
+        state.nodes_parallel += parallel;
+        state.nodes_serial += !parallel;
+    }
+
     for (size_t var_i = 0; var_i < subset_vars.size(); var_i++)
     {
 
@@ -1645,49 +1807,59 @@ void calculate_loglikelihood_categorical(std::vector<double> &loglike, size_t &l
 
         if ((i >= state.p_continuous) && (X_num_unique[i - state.p_continuous] > 1))
         {
-            // if this is a categorical variable, and it still has cutpoints
-            std::vector<double> temp_suff_stat(model->dim_suffstat);
-            std::fill(temp_suff_stat.begin(), temp_suff_stat.end(), 0.0);
-            size_t start, end, end2, n1, temp;
+            auto calcllcat_i = [&, i]()
+            {
+                // if this is a categorical variable, and it still has cutpoints
+                std::vector<double> temp_suff_stat(model->dim_suffstat);
+                std::fill(temp_suff_stat.begin(), temp_suff_stat.end(), 0.0);
+                size_t start, end, end2, n1, temp;
 
-            start = x_struct.variable_ind[i - state.p_continuous];
-            end = x_struct.variable_ind[i + 1 - state.p_continuous] - 1; // minus one for indexing starting at 0
-            end2 = end;
+                start = x_struct.variable_ind[i - state.p_continuous];
+                end = x_struct.variable_ind[i + 1 - state.p_continuous] - 1; // minus one for indexing starting at 0
+                end2 = end;
 
-            while (X_counts[end2] == 0)
-            {
-                // move backward if the last unique value has zero counts
+                while (X_counts[end2] == 0)
+                {
+                    // move backward if the last unique value has zero counts
+                    end2 = end2 - 1;
+                }
+                // move backward again, do not consider the last unique value as cutpoint
                 end2 = end2 - 1;
-            }
-            // move backward again, do not consider the last unique value as cutpoint
-            end2 = end2 - 1;
-
-            n1 = 0;
 
-            for (size_t j = start; j <= end2; j++)
-            {
+                n1 = 0;
 
-                if (X_counts[j] != 0)
+                for (size_t j = start; j <= end2; j++)
                 {
-                    temp = n1 + X_counts[j] - 1;
-                    // modify sufficient statistics vector directly inside model class
-                    calcSuffStat_categorical(state, temp_suff_stat, Xorder_std[i], n1, temp, model);
 
-                    n1 = n1 + X_counts[j];
+                    if (X_counts[j] != 0)
+                    {
+                        temp = n1 + X_counts[j] - 1;
+                        // modify sufficient statistics vector directly inside model class
+                        calcSuffStat_categorical(state, temp_suff_stat, Xorder_std[i], n1, temp, model);
 
-                    loglike[loglike_start + j] = model->likelihood(temp_suff_stat, tree_pointer->suff_stat, n1 - 1, true, false, state) + model->likelihood(temp_suff_stat, tree_pointer->suff_stat, n1 - 1, false, false, state);
+                        n1 = n1 + X_counts[j];
 
-                    // adjust for the difference of number of cutpoints between continuous variable and categorical variables
-                    loglike[loglike_start + j] += -log(x_struct.X_num_unique[i - state.p_continuous]);
+                        loglike[loglike_start + j] = model->likelihood(temp_suff_stat, tree_pointer->suff_stat, n1 - 1, true, false, state) + model->likelihood(temp_suff_stat, tree_pointer->suff_stat, n1 - 1, false, false, state);
 
-                    if (state.p_continuous > 0)
-                    {
-                        loglike[loglike_start + j] += log(state.n_cutpoints);
+                        // adjust for the difference of number of cutpoints between continuous variable and categorical variables
+                        loglike[loglike_start + j] += -log(x_struct.X_num_unique[i - state.p_continuous]);
+
+                        if (state.p_continuous > 0)
+                        {
+                            loglike[loglike_start + j] += log(state.n_cutpoints);
+                        }
                     }
                 }
-            }
+            };
+
+            if (parallel)
+                thread_pool.add_task(calcllcat_i);
+            else
+                calcllcat_i();
         }
     }
+    if (parallel)
+        thread_pool.wait();
 }
 
 void calculate_likelihood_no_split(std::vector<double> &loglike, size_t &N_Xorder, double &loglike_max, Model *model, X_struct &x_struct, size_t &total_categorical_split_candidates, State &state, tree *tree_pointer)
@@ -1801,476 +1973,83 @@ void calcSuffStat_continuous(State &state, std::vector<double> &temp_suff_stat,
     return;
 }
 
-size_t get_split_point(const double *Xpointer, matrix<size_t> &Xorder_std, size_t n_y, size_t v, double c)
+void tree::fit_leaves_all_rows(State &state, Model *model, X_struct &x_struct, const size_t &tree_ind)
 {
-    // get split point
-    // use bisection
-
-    size_t left_ind = 0;
-    size_t right_ind = Xorder_std[0].size() - 1;
-    size_t split_point = (left_ind + right_ind) / 2;
-    double split_val = *(Xpointer + n_y * v + Xorder_std[v][split_point]);
-
-    if (c < *(Xpointer + n_y * v + Xorder_std[v][0]))
-    {
-        COUT << "Warning: cut point less than the smallest value" << endl;
-        split_point = 0;
-    }
-    else if (c > *(Xpointer + n_y * v + Xorder_std[v][right_ind]))
+    // the tree was grown on a subsample of rows, route every row to its leaf
+    // and draw the leaf parameters again from the sufficient statistics of all rows
+    tree::npv bv;
+    this->getbots(bv);
+    for (size_t i = 0; i < bv.size(); i++)
     {
-        COUT << "Warning: cut point greater than the smallest value" << endl;
-        split_point = right_ind;
+        bv[i]->ini_suff_stat();
     }
-    else
-    {
-
-        while ((c != split_val) & (left_ind <= right_ind))
-        {
-            if (split_val > c)
-            {
-                right_ind = split_point - 1;
-            }
-            else
-            {
-                left_ind = split_point + 1;
-            }
-            split_point = (left_ind + right_ind) / 2;
-            split_val = *(Xpointer + n_y * v + Xorder_std[v][split_point]);
-        }
 
-        while ((split_point < Xorder_std[0].size() - 1) && (*(Xpointer + n_y * v + Xorder_std[v][split_point + 1]) == c))
-        {
-            split_point = split_point + 1;
-        }
-    }
-    if (Xorder_std[0].size() == split_point + 1)
+    tree::tree_p bn;
+    for (size_t i = 0; i < state.n_y; i++)
     {
-        COUT << "split_point = N = " << split_point + 1 << endl;
-        COUT << "v = " << v << ", c = " << c << ", min = " << *(Xpointer + n_y * v + Xorder_std[v][0]) << ", max = " << *(Xpointer + n_y * v + Xorder_std[v][right_ind]) << ", N = " << Xorder_std[0].size() << endl;
-        throw;
+        bn = this->search_bottom_std(state.X_std, i, state.p, state.n_y);
+        model->incSuffStat(state, i, bn->suff_stat);
+        x_struct.data_pointers[tree_ind][i] = &bn->theta_vector;
     }
 
-    return split_point;
-}
-
-void split_xorder_std_categorical_simplified(gp_struct &x_struct, matrix<size_t> &Xorder_left_std, matrix<size_t> &Xorder_right_std, size_t split_var, size_t split_point, matrix<size_t> &Xorder_std, std::vector<size_t> &X_counts_left, std::vector<size_t> &X_counts_right, std::vector<size_t> &X_num_unique_left, std::vector<size_t> &X_num_unique_right, std::vector<size_t> &X_counts, size_t p_categorical)
-{
-    // without model, state, don't update suff stats
-
-    // preserve order of other variables
-    size_t N_Xorder = Xorder_std[0].size();
-    size_t N_Xorder_left = Xorder_left_std[0].size();
-    size_t N_Xorder_right = Xorder_right_std[0].size();
-    size_t p = Xorder_std.size();
-    size_t p_continuous = p - p_categorical;
-    const double *temp_pointer = x_struct.X_std + x_struct.n_y * split_var;
-
-    // if the left side is smaller, we only compute sum of it
-    bool compute_left_side = N_Xorder_left < N_Xorder_right;
-
-    double cutvalue = *(x_struct.X_std + x_struct.n_y * split_var + Xorder_std[split_var][split_point]);
-
-    std::fill(X_num_unique_left.begin(), X_num_unique_left.end(), 0.0);
-    std::fill(X_num_unique_right.begin(), X_num_unique_right.end(), 0.0);
-
-    for (size_t i = p_continuous; i < p; i++)
+    for (size_t i = 0; i < bv.size(); i++)
     {
-        // loop over variables
-        size_t left_ix = 0;
-        size_t right_ix = 0;
-
-        // index range of X_counts, X_values that are corresponding to current variable
-        // start <= i <= end;
-        size_t start = x_struct.variable_ind[i - p_continuous];
-        size_t end = x_struct.variable_ind[i + 1 - p_continuous];
-
-        if (i == split_var)
-        {
-            if (compute_left_side)
-            {
-                for (size_t j = 0; j < N_Xorder; j++)
-                {
-                    if (*(temp_pointer + Xorder_std[i][j]) <= cutvalue)
-                    {
-                        Xorder_left_std[i][left_ix] = Xorder_std[i][j];
-                        left_ix = left_ix + 1;
-                    }
-                    else
-                    {
-                        // go to right side
-                        Xorder_right_std[i][right_ix] = Xorder_std[i][j];
-                        right_ix = right_ix + 1;
-                    }
-                }
-            }
-            else
-            {
-                for (size_t j = 0; j < N_Xorder; j++)
-                {
-                    if (*(temp_pointer + Xorder_std[i][j]) <= cutvalue)
-                    {
-                        Xorder_left_std[i][left_ix] = Xorder_std[i][j];
-                        left_ix = left_ix + 1;
-                    }
-                    else
-                    {
-                        Xorder_right_std[i][right_ix] = Xorder_std[i][j];
-                        right_ix = right_ix + 1;
-                    }
-                }
-            }
-
-            // for the cut variable, it's easy to counts X_counts_left and X_counts_right, simply cut X_counts to two pieces.
-
-            for (size_t k = start; k < end; k++)
-            {
-                // loop from start to end!
-
-                if (x_struct.X_values[k] <= cutvalue)
-                {
-                    // smaller than cutvalue, go left
-                    X_counts_left[k] = X_counts[k];
-                }
-                else
-                {
-                    // otherwise go right
-                    X_counts_right[k] = X_counts[k];
-                }
-            }
-        }
-        else
-        {
-            size_t X_counts_index = start;
-            // split other variables, need to compare each row
-            for (size_t j = 0; j < N_Xorder; j++)
-            {
-                while (*(x_struct.X_std + x_struct.n_y * i + Xorder_std[i][j]) != x_struct.X_values[X_counts_index])
-                {
-                    //     // for the current observation, find location of corresponding unique values
-                    X_counts_index++;
-                }
-
-                if (*(temp_pointer + Xorder_std[i][j]) <= cutvalue)
-                {
-                    // go to left side
-                    Xorder_left_std[i][left_ix] = Xorder_std[i][j];
-                    left_ix = left_ix + 1;
-                    X_counts_left[X_counts_index]++;
-                }
-                else
-                {
-                    // go to right side
-                    Xorder_right_std[i][right_ix] = Xorder_std[i][j];
-                    right_ix = right_ix + 1;
-                    X_counts_right[X_counts_index]++;
-                }
-            }
-        }
-
-        for (size_t j = start; j < end; j++)
-        {
-            if (X_counts_left[j] > 0)
-            {
-                X_num_unique_left[i - p_continuous] = X_num_unique_left[i - p_continuous] + 1;
-            }
-            if (X_counts_right[j] > 0)
-            {
-                X_num_unique_right[i - p_continuous] = X_num_unique_right[i - p_continuous] + 1;
-            }
-        }
+        model->samplePars(state, bv[i]->suff_stat, bv[i]->theta_vector, bv[i]->prob_leaf);
     }
     return;
 }
 
-void split_xorder_std_continuous_simplified(gp_struct &x_struct, matrix<size_t> &Xorder_left_std, matrix<size_t> &Xorder_right_std, size_t split_var, size_t split_point, matrix<size_t> &Xorder_std, size_t p_continuous)
+void subsample_xorder_std(State &state, X_struct &x_struct, matrix<size_t> &Xorder_std, std::vector<bool> &row_in, matrix<size_t> &Xorder_sub_std, std::vector<size_t> &X_counts_sub, std::vector<size_t> &X_num_unique_sub)
 {
-    // without model, state, don't update suff stats
-
-    size_t N_Xorder = Xorder_std[0].size();
-
-    double cutvalue = *(x_struct.X_std + x_struct.n_y * split_var + Xorder_std[split_var][split_point]);
-
-    const double *split_var_x_pointer = x_struct.X_std + x_struct.n_y * split_var;
-
-    for (size_t i = 0; i < p_continuous; i++) // loop over variables
-    {
-        size_t left_ix = 0;
-        size_t right_ix = 0;
-
-        std::vector<size_t> &xo = Xorder_std[i];
-        std::vector<size_t> &xo_left = Xorder_left_std[i];
-        std::vector<size_t> &xo_right = Xorder_right_std[i];
-
-        for (size_t j = 0; j < N_Xorder; j++)
-        {
-            if (*(split_var_x_pointer + xo[j]) <= cutvalue)
-            {
-                xo_left[left_ix] = xo[j];
-                left_ix = left_ix + 1;
-            }
-            else
-            {
-                xo_right[right_ix] = xo[j];
-                right_ix = right_ix + 1;
-            }
-        }
-    }
-    return;
-}
-
-void tree::gp_predict_from_root(matrix<size_t> &Xorder_std, gp_struct &x_struct, std::vector<size_t> &X_counts, std::vector<size_t> &X_num_unique, matrix<size_t> &Xtestorder_std, gp_struct &xtest_struct, std::vector<size_t> &Xtest_counts, std::vector<size_t> &Xtest_num_unique, matrix<double> &yhats_test_xinfo, std::vector<bool> active_var, const size_t &p_categorical, const size_t &sweeps, const size_t &tree_ind, const double &theta, const double &tau)
-{
-    // gaussian process prediction from root
+    // draw round(subsample * N) rows without replacement (selection sampling)
+    // and filter the presorted columns of Xorder_std, so that no column is sorted again
     size_t N = Xorder_std[0].size();
-    size_t Ntest = Xtestorder_std[0].size();
-    size_t p = active_var.size();
-    size_t p_continuous = p - p_categorical;
+    size_t p = Xorder_std.size();
+    size_t n_sub = std::max((size_t)round(state.subsample * N), (size_t)1);
 
-    if (Ntest == 0)
-    { // no need to split if Ntest = 0
-        return;
+    std::uniform_real_distribution<double> unif(0.0, 1.0);
+    size_t needed = n_sub;
+    for (size_t i = 0; i < N; i++)
+    {
+        row_in[i] = needed > 0 && unif(state.gen) * (N - i) < needed;
+        needed -= row_in[i];
     }
 
-    if (this->l)
+    Xorder_sub_std.resize(p);
+    for (size_t j = 0; j < p; j++)
     {
-        active_var[v] = true;
-        std::vector<bool> active_var_left(active_var.size());
-        std::vector<bool> active_var_right(active_var.size());
-        std::copy(active_var.begin(), active_var.end(), active_var_left.begin());
-        std::copy(active_var.begin(), active_var.end(), active_var_right.begin());
-
-        matrix<size_t> Xorder_left_std;
-        matrix<size_t> Xorder_right_std;
-        matrix<size_t> Xtestorder_left_std;
-        matrix<size_t> Xtestorder_right_std;
-
-        std::vector<size_t> X_num_unique_left(X_num_unique.size());
-        std::vector<size_t> X_num_unique_right(X_num_unique.size());
-
-        std::vector<size_t> X_counts_left(X_counts.size());
-        std::vector<size_t> X_counts_right(X_counts.size());
-
-        std::vector<size_t> Xtest_num_unique_left(Xtest_num_unique.size());
-        std::vector<size_t> Xtest_num_unique_right(Xtest_num_unique.size());
-
-        std::vector<size_t> Xtest_counts_left(Xtest_counts.size());
-        std::vector<size_t> Xtest_counts_right(Xtest_counts.size());
-
-        if (N > 0)
+        Xorder_sub_std[j].resize(n_sub);
+        size_t k = 0;
+        for (auto &&i : Xorder_std[j])
         {
-            // get split point
-            size_t split_point = get_split_point(x_struct.X_std, Xorder_std, x_struct.n_y, v, c);
-            ini_xinfo_sizet(Xorder_left_std, split_point + 1, p);
-            ini_xinfo_sizet(Xorder_right_std, N - split_point - 1, p);
-
-            if (p_categorical > 0)
-            {
-                split_xorder_std_categorical_simplified(x_struct, Xorder_left_std, Xorder_right_std, this->v, split_point, Xorder_std, X_counts_left, X_counts_right,
-                                                        X_num_unique_left, X_num_unique_right, X_counts, p_categorical);
-            }
-
-            if (p_continuous > 0)
-            {
-                split_xorder_std_continuous_simplified(x_struct, Xorder_left_std, Xorder_right_std, v, split_point, Xorder_std, p_continuous);
-            }
-        }
-
-        if (Ntest > 0)
-        {
-
-            if (c < *(xtest_struct.X_std + xtest_struct.n_y * v + Xtestorder_std[v][0]))
-            {
-                // all test data goes to the right node
-                this->r->gp_predict_from_root(Xorder_right_std, x_struct, X_counts_right, X_num_unique_right,
-                                              Xtestorder_std, xtest_struct, Xtest_counts, Xtest_num_unique, yhats_test_xinfo, active_var_right, p_categorical, sweeps, tree_ind, theta, tau);
-                return;
-            }
-            if (c >= *(xtest_struct.X_std + xtest_struct.n_y * v + Xtestorder_std[v][Ntest - 1]))
-            {
-                // all test data goes to the left node
-                this->l->gp_predict_from_root(Xorder_left_std, x_struct, X_counts_left, X_num_unique_left,
-                                              Xtestorder_std, xtest_struct, Xtest_counts, Xtest_num_unique, yhats_test_xinfo, active_var_left, p_categorical, sweeps, tree_ind, theta, tau);
-                return;
-            }
-
-            size_t test_split_point = get_split_point(xtest_struct.X_std, Xtestorder_std, xtest_struct.n_y, v, c);
-
-            ini_xinfo_sizet(Xtestorder_left_std, test_split_point + 1, p);
-            ini_xinfo_sizet(Xtestorder_right_std, Ntest - test_split_point - 1, p);
-
-            if (p_categorical > 0)
-            {
-                split_xorder_std_categorical_simplified(xtest_struct, Xtestorder_left_std, Xtestorder_right_std, v, test_split_point, Xtestorder_std, Xtest_counts_left, Xtest_counts_right, Xtest_num_unique_left, Xtest_num_unique_right, Xtest_counts, p_categorical);
-            }
-            if (p_continuous > 0)
+            if (row_in[i])
             {
-                split_xorder_std_continuous_simplified(xtest_struct, Xtestorder_left_std, Xtestorder_right_std, v, test_split_point, Xtestorder_std, p_continuous);
+                Xorder_sub_std[j][k++] = i;
             }
         }
-
-        this->l->gp_predict_from_root(Xorder_left_std, x_struct, X_counts_left, X_num_unique_left,
-                                      Xtestorder_left_std, xtest_struct, Xtest_counts_left, Xtest_num_unique_left, yhats_test_xinfo, active_var_left, p_categorical, sweeps, tree_ind, theta, tau);
-
-        this->r->gp_predict_from_root(Xorder_right_std, x_struct, X_counts_right, X_num_unique_right,
-                                      Xtestorder_right_std, xtest_struct, Xtest_counts_right, Xtest_num_unique_right, yhats_test_xinfo, active_var_right, p_categorical, sweeps, tree_ind, theta, tau);
     }
-    else
-    {
-        if (N == 0)
-        {
-            COUT << "0 training data in the leaf node" << endl;
-            throw;
-        }
-        // assign mu
-        for (size_t i = 0; i < Ntest; i++)
-        {
-            yhats_test_xinfo[sweeps][Xtestorder_std[0][i]] += this->theta_vector[0];
-        }
-
-        // get local range
-        matrix<double> local_X_range;
-        get_X_range(x_struct.X_std, Xorder_std, local_X_range, x_struct.n_y);
-
-        // check out of range test sets
-        // exterior points may not be out-of-range on all active variables
-        // do we want to use all acitve_var info or just those having out-of-range points?
-        // FOR NOW: just those having out-of-range points
-        std::vector<size_t> test_ind;
-        std::vector<bool> active_var_out_range(p_continuous, false);
-        for (size_t i = 0; i < Ntest; i++)
-        {
-            for (size_t j = 0; j < p_continuous; j++)
-            {
-                if (active_var[j])
-                {
-                    if (*(xtest_struct.X_std + xtest_struct.n_y * j + Xtestorder_std[j][i]) > local_X_range[j][1])
-                    {
-                        test_ind.push_back(Xtestorder_std[j][i]);
-                        active_var_out_range[j] = true;
-                        break;
-                    }
-                    else if (*(xtest_struct.X_std + xtest_struct.n_y * j + Xtestorder_std[j][i]) < local_X_range[j][0])
-                    {
-                        test_ind.push_back(Xtestorder_std[j][i]);
-                        active_var_out_range[j] = true;
-                        break;
-                    }
-                }
-            }
-        }
-
-        // construct covariance matrix
-        // TODO: consider categorical active variables
-        size_t p_active = std::accumulate(active_var_out_range.begin(), active_var_out_range.end(), 0);
-        if (p_active == 0)
-        {
-            return;
-        }
 
-        Ntest = test_ind.size();
-        if (Ntest == 0)
-        {
-            return;
-        }
-
-        // get training set
-        std::vector<size_t> train_ind;
-        if (N < 100)
-        {
-            train_ind.resize(N);
-            std::copy(Xorder_std[0].begin(), Xorder_std[0].end(), train_ind.begin());
-        }
-        else
-        {
-            N = 100;
-            train_ind.resize(100);
-            std::sample(Xorder_std[0].begin(), Xorder_std[0].end(), train_ind.begin(), 100, x_struct.gen);
-        }
-
-        mat X(N + Ntest, p_active);
-        std::vector<double> x_range(p_active);
-        const double *split_var_x_pointer;
-        size_t j_count = 0;
-        for (size_t j = 0; j < p_continuous; j++)
+    // counts of unique values of categorical variables, values are in the same increasing order as X_values
+    X_counts_sub.assign(x_struct.X_counts.size(), 0);
+    X_num_unique_sub.assign(x_struct.X_num_unique.size(), 0);
+    for (size_t j = state.p_continuous; j < p; j++)
+    {
+        size_t start = x_struct.variable_ind[j - state.p_continuous];
+        size_t end = x_struct.variable_ind[j + 1 - state.p_continuous];
+        const double *x_pointer = state.X_std + state.n_y * j;
+        size_t k = start;
+        for (auto &&i : Xorder_sub_std[j])
         {
-            if (active_var_out_range[j])
+            while (x_struct.X_values[k] != *(x_pointer + i))
             {
-                split_var_x_pointer = x_struct.X_std + x_struct.n_y * j;
-                for (size_t i = 0; i < N; i++)
-                {
-                    X(i, j_count) = *(split_var_x_pointer + train_ind[i]);
-                }
-
-                // if (local_X_range[j][1] > local_X_range[j][0]){
-                //     x_range[j_count] = sqrt(local_X_range[j][1] - local_X_range[j][0]);
-                // }else{
-                //     x_range[j_count] =  sqrt(*(split_var_x_pointer + Xorder_std[j][Xorder_std[j].size()-1]) - *(split_var_x_pointer + Xorder_std[j][0]));
-                // }
-                if (local_X_range[j][1] > local_X_range[j][0])
-                {
-                    x_range[j_count] = (local_X_range[j][1] - local_X_range[j][0]);
-                }
-                else
-                {
-                    x_range[j_count] = (*(split_var_x_pointer + Xorder_std[j][Xorder_std[j].size() - 1]) - *(split_var_x_pointer + Xorder_std[j][0]));
-                }
-
-                split_var_x_pointer = xtest_struct.X_std + xtest_struct.n_y * j;
-                for (size_t i = 0; i < Ntest; i++)
-                {
-                    X(i + N, j_count) = *(split_var_x_pointer + test_ind[i]);
-                }
-
-                if (x_range[j_count] == 0)
-                {
-                    COUT << "x_range = 0"
-                         << ", j = " << j << endl;
-                    throw;
-                }
-                j_count += 1;
+                k++;
             }
+            X_counts_sub[k]++;
         }
-
-        mat resid(N, 1);
-        for (size_t i = 0; i < N; i++)
-        {
-            resid(i, 0) = x_struct.resid[sweeps][tree_ind][train_ind[i]] - this->theta_vector[0];
-        }
-
-        mat cov(N + Ntest, N + Ntest);
-        get_rel_covariance(cov, X, x_range, theta, tau);
-        for (size_t i = 0; i < N; i++)
-        {
-            cov(i, i) += pow(x_struct.sigma[tree_ind], 2) / x_struct.num_trees;
-        }
-
-        mat mu(Ntest, 1);
-        mat Sig(Ntest, Ntest);
-        if (N > 0)
+        for (k = start; k < end; k++)
         {
-            mat k = cov.submat(N, 0, N + Ntest - 1, N - 1);
-            mat Kinv = pinv(cov.submat(0, 0, N - 1, N - 1));
-            mu = k * Kinv * resid;
-            Sig = cov.submat(N, N, N + Ntest - 1, N + Ntest - 1) - k * Kinv * trans(k);
+            X_num_unique_sub[j - state.p_continuous] += (X_counts_sub[k] > 0);
         }
-        else
-        {
-            // prior
-            mu.zeros(Ntest, 1);
-            Sig = cov.submat(0, 0, Ntest - 1, Ntest - 1);
-        }
-        mat U;
-        vec S;
-        mat V;
-        svd(U, S, V, Sig);
-
-        std::normal_distribution<double> normal_samp(0.0, 1.0);
-        mat samp(Ntest, 1);
-        for (size_t i = 0; i < Ntest; i++)
-            samp(i, 0) = normal_samp(x_struct.gen);
-        mat draws = mu + U * diagmat(sqrt(S)) * samp;
-        for (size_t i = 0; i < Ntest; i++)
-            yhats_test_xinfo[sweeps][test_ind[i]] += draws(i, 0);
     }
     return;
 }
@@ -2401,5 +2180,80 @@ void getThetaForObs_Outsample_ave(matrix<double> &output, std::vector<tree> &tre
     return;
 }
 
+void getLeafIndex_Outsample(std::vector<uint16_t> &leaf_index, std::vector<std::vector<tree>> &trees, const double *Xtest, size_t N_Xtest, size_t p)
+{
+    // get index of the leaf node reached by ALL observations in ALL trees, out sample
+    // leaves of a tree are numbered from 0 in the order of getbots (left to right)
+    // the compiled forest numbers its leaves in the same order, so the leaf reached gives the index directly
+
+    // output is stacked as a vector, N_Xtest * num_sweeps * num_trees, same as predict_whole_std
+
+    size_t num_sweeps = trees.size();
+    size_t num_trees = trees[0].size();
+
+    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    {
+        for (size_t i = 0; i < num_trees; i++)
+        {
+            if (trees[sweeps][i].nbots() > UINT16_MAX)
+            {
+                throw std::range_error("number of leaves exceeds the range of leaf index");
+            }
+        }
+    }
+
+    compiled_forest forest(trees);
+    if (forest.p > p)
+    {
+        throw std::range_error("testing data has fewer columns than the split variables of the forest");
+    }
+
+    // row major copy of one observation
+    std::vector<double> row(p);
+    for (size_t data_ind = 0; data_ind < N_Xtest; data_ind++)
+    {
+        for (size_t j = 0; j < p; j++)
+        {
+            row[j] = Xtest[data_ind + j * N_Xtest];
+        }
+        for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+        {
+            for (size_t i = 0; i < num_trees; i++)
+            {
+                leaf_index[data_ind + sweeps * N_Xtest + i * num_sweeps * N_Xtest] = (uint16_t)forest.leaf_number(forest.search_leaf_index(row.data(), sweeps, i));
+            }
+        }
+    }
+    return;
+}
+
+void getLeafValues(matrix<double> &leaf_values, std::vector<std::vector<tree>> &trees)
+{
+    // get leaf parameters (first entry of theta_vector) of ALL trees
+    // leaf_values[sweeps + i * num_sweeps] lists the leaves of tree i in sweep sweeps, in the order of getbots
+
+    size_t num_sweeps = trees.size();
+    size_t num_trees = trees[0].size();
+
+    leaf_values.resize(num_sweeps * num_trees);
+
+    tree::npv bv;
+    for (size_t sweeps = 0; sweeps < num_sweeps; sweeps++)
+    {
+        for (size_t i = 0; i < num_trees; i++)
+        {
+            bv.clear();
+            trees[sweeps][i].getbots(bv);
+
+            leaf_values[sweeps + i * num_sweeps].resize(bv.size());
+            for (size_t j = 0; j < bv.size(); j++)
+            {
+                leaf_values[sweeps + i * num_sweeps][j] = bv[j]->theta_vector[0];
+            }
+        }
+    }
+    return;
+}
+
 #ifndef NoRcpp
 #endif
@@ -4,6 +4,7 @@
 #include <map>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include "common.h"
 #include "sample_int_crank.h"
 #include "model.h"
@@ -19,6 +20,15 @@ void calcSuffStat_categorical(State &state, std::vector<double> &temp_suff_stat,
 
 void calcSuffStat_continuous(State &state, std::vector<double> &temp_suff_stat, std::vector<size_t> &xorder, std::vector<size_t> &candidate_index, size_t index, bool adaptive_cutpoint, Model *model, matrix<double> &residual_std);
 
+// fill state.split_mask with the left child membership of the observations of a node before its columns are partitioned
+void split_mask_std(State &state, matrix<size_t> &Xorder_std, size_t split_var, size_t split_point);
+
+// whether the per variable tasks of a node with N rows and n_vars variables run on the thread pool
+bool parallel_node(State &state, size_t N, size_t n_vars);
+
+// number of row blocks per variable for the continuous split search at a node, 1 for one task per variable
+size_t split_search_blocks(State &state, size_t N, size_t n_vars);
+
 // void calc_suff_continuous(std::vector<size_t> &xorder, std::vector<double> &y_std, std::vector<size_t> &candidate_index, size_t index, double &suff_stat, bool adaptive_cutpoint);
 
 //--------------------------------------------------
@@ -166,9 +176,8 @@ public:
 
     void grow_from_root_separate_tree(State &state, matrix<size_t> &Xorder_std, std::vector<size_t> &X_counts, std::vector<size_t> &X_num_unique, Model *model, X_struct &x_struct, const size_t &sweeps, const size_t &tree_ind);
 
-    void gp_predict_from_root(matrix<size_t> &Xorder_std, gp_struct &x_struct, std::vector<size_t> &X_counts, std::vector<size_t> &X_num_unique,
-                              matrix<size_t> &Xtestorder_std, gp_struct &xtest_struct, std::vector<size_t> &Xtest_counts, std::vector<size_t> &Xtest_num_unique,
-                              matrix<double> &yhats_test_xinfo, std::vector<bool> active_var, const size_t &p_categorical, const size_t &sweeps, const size_t &tree_ind, const double &theta, const double &tau);
+    // route all rows to leaves of a tree grown on a subsample, redraw leaf parameters from sufficient statistics of all rows
+    void fit_leaves_all_rows(State &state, Model *model, X_struct &x_struct, const size_t &tree_ind);
 
     tree_p bn(double *x, matrix<double> &xi); // find Bottom Node, original BART version
 
@@ -210,12 +219,6 @@ public:
 
     friend void calculate_entropy(matrix<size_t> &Xorder_std, State &state, std::vector<double> &theta_vector, double &entropy);
 
-    friend size_t get_split_point(const double *Xpointer, matrix<size_t> &Xorder_std, size_t n_y, size_t v, double c);
-
-    friend void split_xorder_std_categorical_simplified(X_struct &x_struct, matrix<size_t> &Xorder_left_std, matrix<size_t> &Xorder_right_std, size_t split_var, size_t split_point, matrix<size_t> &Xorder_std, std::vector<size_t> &X_counts_left, std::vector<size_t> &X_counts_right, std::vector<size_t> &X_num_unique_left, std::vector<size_t> &X_num_unique_right, std::vector<size_t> &X_counts, size_t p_categorical);
-
-    friend void split_xorder_std_continuous_simplified(X_struct &x_struct, matrix<size_t> &Xorder_left_std, matrix<size_t> &Xorder_right_std, size_t split_var, size_t split_point, matrix<size_t> &Xorder_std, size_t p_continuous);
-
     // #ifndef NoRcpp
     // #endif
 private:
@@ -268,4 +271,10 @@ void getThetaForObs_Outsample(matrix<double> &output, std::vector<tree> &tree, s
 
 void getThetaForObs_Outsample_ave(matrix<double> &output, std::vector<tree> &tree, size_t x_index, const double *Xtest, size_t N_Xtest, size_t p);
 
+void getLeafIndex_Outsample(std::vector<uint16_t> &leaf_index, std::vector<std::vector<tree>> &trees, const double *Xtest, size_t N_Xtest, size_t p);
+
+void getLeafValues(matrix<double> &leaf_values, std::vector<std::vector<tree>> &trees);
+
+void subsample_xorder_std(State &state, X_struct &x_struct, matrix<size_t> &Xorder_std, std::vector<bool> &row_in, matrix<size_t> &Xorder_sub_std, std::vector<size_t> &X_counts_sub, std::vector<size_t> &X_num_unique_sub);
+
 #endif
@@ -1,11 +1,8 @@
 #include "utility.h"
 #include <gsl/gsl_sf_bessel.h>
-#include <Rcpp.h>
 
 ThreadPool thread_pool;
 
-using namespace Rcpp;
-
 void ini_xinfo(matrix<double> &X, size_t N, size_t p)
 {
     // matrix<double> X;
@@ -101,6 +98,56 @@ double sum_vec(std::vector<double> &v)
     return output;
 }
 
+void log_sum_exp_normalize(double *x, size_t n)
+{
+    // x is log of unnormalized probabilities, overwritten by normalized probabilities
+    // subtract max to avoid overflow, exp and normalizing constant are computed in one pass
+    double max_x = -INFINITY;
+    for (size_t k = 0; k < n; k++)
+    {
+        max_x = std::max(max_x, x[k]);
+    }
+
+    double denom = 0.0;
+    for (size_t k = 0; k < n; k++)
+    {
+        x[k] = exp(x[k] - max_x);
+        denom += x[k];
+    }
+
+    double inv_denom = 1.0 / denom;
+    for (size_t k = 0; k < n; k++)
+    {
+        x[k] *= inv_denom;
+    }
+    return;
+}
+
+void vec_quantile(std::vector<double> &v, const std::vector<double> &probs, std::vector<double> &output)
+{
+    // sample quantiles of v, same interpolation as R's default quantile(type = 7)
+    // v is sorted in place, output has the same length as probs, probs must be in [0, 1] (checked by callers)
+    size_t N = v.size();
+    std::sort(v.begin(), v.end());
+
+    double h;
+    size_t lo;
+    for (size_t k = 0; k < probs.size(); k++)
+    {
+        h = (N - 1) * probs[k];
+        lo = (size_t)floor(h);
+        if (lo + 1 >= N)
+        {
+            output[k] = v[N - 1];
+        }
+        else
+        {
+            output[k] = v[lo] + (h - lo) * (v[lo + 1] - v[lo]);
+        }
+    }
+    return;
+}
+
 void seq_gen_std(size_t start, size_t end, size_t length_out, std::vector<size_t> &vec)
 {
     // generate a sequence of integers, save in std vector container
@@ -230,23 +277,21 @@ void unique_value_count2(const double *Xpointer, matrix<size_t> &Xorder_std, std
     return;
 }
 
-void get_X_range(const double *Xpointer, std::vector<std::vector<size_t>> &Xorder_std, std::vector<std::vector<double>> &X_range, size_t &n_y)
+void merge_xorder_std(const double *Xpointer, size_t N, size_t N_old, matrix<size_t> &Xorder_std)
 {
-    size_t N = Xorder_std[0].size();
-    size_t p = Xorder_std.size();
-    ini_matrix(X_range, 2, p);
-
-    // get 95% quantile to avoid outliers
-    double alpha = 0.05;
-    size_t low_idx = (size_t)floor(N * alpha / 2);
-    size_t up_idx = (size_t)floor(N * (1 - alpha / 2));
-
-    for (size_t i = 0; i < p; i++)
+    // Xorder_std[j] holds the order of the first N_old rows on entry
+    // only the new rows are sorted, then merged with the old order in linear time
+    for (size_t j = 0; j < Xorder_std.size(); j++)
     {
-        // X_range[i][0] = *(Xpointer + i * n_y + Xorder_std[i][0]);
-        // X_range[i][1] = *(Xpointer + i * n_y + Xorder_std[i][N-1]);
-        X_range[i][0] = *(Xpointer + i * n_y + Xorder_std[i][low_idx]);
-        X_range[i][1] = *(Xpointer + i * n_y + Xorder_std[i][up_idx]);
+        const double *x = Xpointer + N * j;
+        auto less = [x](size_t a, size_t b)
+        { return x[a] < x[b]; };
+
+        std::vector<size_t> &xorder = Xorder_std[j];
+        xorder.resize(N);
+        std::iota(xorder.begin() + N_old, xorder.end(), N_old);
+        std::stable_sort(xorder.begin() + N_old, xorder.end(), less);
+        std::inplace_merge(xorder.begin(), xorder.begin() + N_old, xorder.end(), less);
     }
     return;
 }
@@ -337,6 +382,25 @@ void get_rel_covariance(mat &cov, mat &X, std::vector<double> X_range, double th
     return;
 }
 
+void get_rel_cross_covariance(mat &cov, mat &X1, mat &X2, std::vector<double> &X_range, double theta, double tau)
+{
+    double temp;
+    cov.set_size(X1.n_rows, X2.n_rows);
+    for (size_t j = 0; j < X2.n_rows; j++)
+    {
+        for (size_t i = 0; i < X1.n_rows; i++)
+        {
+            temp = 0;
+            for (size_t k = 0; k < X1.n_cols; k++)
+            {
+                temp += pow(X1(i, k) - X2(j, k), 2) / pow(X_range[k], 2) / 2;
+            }
+            cov(i, j) = tau * exp(-theta * temp);
+        }
+    }
+    return;
+}
+
 double sum_vec_yz(std::vector<double> &v, matrix<double> &z)
 {
     double output = 0;
@@ -377,252 +441,224 @@ double sum_vec_y_z(std::vector<double> &v, matrix<double> &z)
     return output;
 }
 
-double drawlambdafromR(size_t n, double sy, double c, double d, std::mt19937& gen)
+double drawlambda(size_t n, double sy, double c, double d, std::mt19937 &gen)
 {
-    double logz1 = loggignorm(-c+n, 2*d, 2*sy);
-    double logz2 = loggignorm(c+n, 0, 2*(d+sy));
-    // cout << "z1 = " << z1 << " z2 = " << z2 << endl;
+    /////////////////////////// generalize inversed Gaussian distribution
+    // lambda ~ pi*GIG(-c+r, 2d, 2s) + (1-pi)*Gamma(c+r, d+s)
+    // pi = Z(-c+r, 2*d, 2*s) / (Z(-c+r, 2d, 2s) + Z(c+r, 0, 2*(d+s)))
+    // r = n, s = sy
+    double logz1 = loggignorm(-c + n, 2 * d, 2 * sy);
+    double logz2 = loggignorm(c + n, 0, 2 * (d + sy));
     // double _pi =  z1 / (z1+z2) = 1 / (1 + z2 / z1) = 1 / (1 + exp(log(z2 / z1))) = 1 / (1 + exp(log(z2) - log(z1)))
     double _pi = 1 / (1 + exp(logz2 - logz1));
-    double ret;
     std::uniform_real_distribution<double> udist(0, 1);
 
-    if (udist(gen) < _pi){ // draw from gig(-c+r, 2*d, 2*s)
-        double eta = -c + n; 
-        double chi = 2*d;
-        double psi = 2*sy;
-        Function f("rgig");
-        NumericVector ret_r = f(1, eta, chi, psi);
-        ret = ret_r(0);
-        // if (ret > 1000)
-        // {   
-        //     cout << "pi " << _pi << " logz1 " << logz1 << " logz2 " << logz2 << " z1 " << exp(logz1) << " z2" << exp(logz2) << endl;
-        //     cout << "gig " << " eta " << eta << " chi " << chi << " psi " << psi << " ret " << ret << endl;
-        // }
-    } else { 
+    if (udist(gen) < _pi)
+    {
+        // draw from gig(-c+r, 2*d, 2*s)
+        return rgig(-c + n, 2 * d, 2 * sy, gen);
+    }
+    else
+    {
         // draw from gig(c+r, 0, 2*(d+s)) or equivalently gamma(c+r, d+s)
+        return rgig(c + n, 0, 2 * (d + sy), gen);
+    }
+}
+
+// generalized inverse Gaussian distribution, density proportional to x^(lambda-1) exp(-(chi/x + psi*x)/2)
+// Hormann, W. and Leydold, J. (2014) Generating generalized inverse Gaussian random variates, Statistics and Computing
+// same algorithms as the R package GIGrvg, the helpers draw X ~ GIG(lambda, omega, omega) with lambda >= 0
 
-        double eta = c + n; 
-        double chi = 0;
-        double psi = 2*(d+sy);
-        Function f("rgig");
-        NumericVector ret_r = f(1, eta, chi, psi);
-        ret = ret_r(0);
-        // if (ret > 1000)
-        // {   
-        //     cout << "pi " << _pi << " logz1 " << logz1 << " logz2 " << logz2 << " z1 " << exp(logz1) << " z2" << exp(logz2) << endl;
-        //     cout << "gamma " << " eta " << eta << " chi " << chi << " psi " << psi << " ret " << ret << endl;
-        // }
-
-        // cout << "draw from gamma" << endl;
-        // std::gamma_distribution gammadist(c+n, d+sy);  
-        // ret = gammadist(gen);
-        // if (ret > 1000)
-        // {
-        //     cout << "pi " << _pi << " logz1 " << logz1 << " logz2 " << logz2 << " z1 " << exp(logz1) << " z2" << exp(logz2) << endl;
-        //     cout << "gamma dist " << " c+n " << c+n << " d+sy " << d+sy << " ret " << ret << endl;
-        // }
+static double gig_mode(double lambda, double omega)
+{
+    // mode of x^(lambda-1) exp(-omega/2 (x + 1/x))
+    if (lambda >= 1.0)
+    {
+        return (sqrt((lambda - 1.0) * (lambda - 1.0) + omega * omega) + (lambda - 1.0)) / omega;
+    }
+    else
+    {
+        return omega / (sqrt((1.0 - lambda) * (1.0 - lambda) + omega * omega) + (1.0 - lambda));
     }
-    return ret;
 }
 
-double drawnodelambda(size_t n, double sy, double c, double d, std::mt19937& gen)
-{ 
-    /////////////////////////// generalize inversed Gaussian distribution
-    // lambda ~ pi*GIG(-c+r, 2d, 2s) + (1-pi)*Gamma(c+r, d+s)
-    // pi = Z(-c+r, 2*d, 2*s) / (Z(-c+r, 2d, 2s) + Z(c+r, 0, 2*(d+s)))
-    // r = n, s = sy
-    // cout << "n = " << n << " sy = " << sy << endl;
-    double logz1 = loggignorm(-c+n, 2*d, 2*sy);
-    double logz2 = loggignorm(c+n, 0, 2*(d+sy));
-    // cout << "z1 = " << z1 << " z2 = " << z2 << endl;
-    // double _pi =  z1 / (z1+z2) = 1 / (1 + z2 / z1) = 1 / (1 + exp(log(z2 / z1))) = 1 / (1 + exp(log(z2) - log(z1)))
-    double _pi = 1 / (1 + exp(logz2 - logz1));
+static double rgig_ROU_noshift(double lambda, double omega, std::mt19937 &gen)
+{
+    // ratio-of-uniforms without mode shift, for 0 <= lambda <= 1, omega >= min(1/2, 2/3 sqrt(1-lambda))
+    std::uniform_real_distribution<double> udist(0, 1);
+    double t = 0.5 * (lambda - 1.0);
+    double s = 0.25 * omega;
+
+    double xm = gig_mode(lambda, omega);
+    double nc = t * log(xm) - s * (xm + 1.0 / xm); // log of normalizing constant
+
+    // location of maximum of x * sqrt(f(x))
+    double ym = ((lambda + 1.0) + sqrt((lambda + 1.0) * (lambda + 1.0) + omega * omega)) / omega;
+    double um = exp(0.5 * (lambda + 1.0) * log(ym) - s * (ym + 1.0 / ym) - nc);
+
+    double U, V, X;
+    do
+    {
+        U = um * udist(gen);
+        V = udist(gen);
+        X = U / V;
+    } while (log(V) > (t * log(X) - s * (X + 1.0 / X) - nc));
+    return X;
+}
 
+static double rgig_ROU_shift(double lambda, double omega, std::mt19937 &gen)
+{
+    // ratio-of-uniforms with mode shift, for lambda > 1 or omega > 1
     std::uniform_real_distribution<double> udist(0, 1);
+    double t = 0.5 * (lambda - 1.0);
+    double s = 0.25 * omega;
 
-    if (udist(gen) < _pi){ // draw from gig(-c+r, 2*d, 2*s)
-        double eta = -c + n; 
-        double chi = 2*d;
-        double psi = 2*sy;
-        size_t num_try = 0;
-        double u, v, x;
-
-        double lambda = abs(eta);
-        double beta = sqrt(chi*psi);
-        double ret;
-
-        if ((eta < 0) && (abs(psi) < pow(10, -6))) 
-            psi = 0;
-        
-        // Check Domain
-        if ((eta > 0) && !((psi > 0) && (chi >= 0))) {
-            cout << "Out of domain " << "eta = " << eta << " chi = " << chi << " psi = " << psi << endl;
-            exit(1);
-        } else if ((eta == 0) && !((psi > 0) && (chi > 0))){
-            cout << "Out of domain " << "eta = " << eta << " chi = " << chi << " psi = " << psi << endl;
-            exit(1);
-        } else if ((eta < 0) && !((psi >= 0) && (chi > 0))){
-            cout << "Out of domain " << "eta = " << eta << " chi = " << chi << " psi = " << psi << endl;
-            exit(1);
-        }
+    double xm = gig_mode(lambda, omega);
+    double nc = t * log(xm) - s * (xm + 1.0 / xm);
+
+    // minimal bounding rectangle, roots of a cubic equation by Cardano's formula
+    double a = -(2.0 * (lambda + 1.0) / omega + xm);
+    double b = (2.0 * (lambda - 1.0) * xm / omega - 1.0);
+    double c = xm;
+
+    double p = b - a * a / 3.0;
+    double q = (2.0 * a * a * a) / 27.0 - (a * b) / 3.0 + c;
+
+    double fi = acos(-q / (2.0 * sqrt(-(p * p * p) / 27.0)));
+    double fak = 2.0 * sqrt(-p / 3.0);
+    double y1 = fak * cos(fi / 3.0) - a / 3.0;
+    double y2 = fak * cos(fi / 3.0 + 4.0 / 3.0 * M_PI) - a / 3.0;
+
+    double uplus = (y1 - xm) * exp(t * log(y1) - s * (y1 + 1.0 / y1) - nc);
+    double uminus = (y2 - xm) * exp(t * log(y2) - s * (y2 + 1.0 / y2) - nc);
+
+    double U, V, X;
+    do
+    {
+        U = uminus + udist(gen) * (uplus - uminus);
+        V = udist(gen);
+        X = U / V + xm;
+    } while ((X <= 0.0) || (log(V) > (t * log(X) - s * (X + 1.0 / X) - nc)));
+    return X;
+}
+
+static double rgig_concave(double lambda, double omega, std::mt19937 &gen)
+{
+    // rejection from a dominating density with three pieces, for the non T-concave case
+    // 0 <= lambda < 1, 0 < omega <= 2/3 sqrt(1-lambda)
+    std::uniform_real_distribution<double> udist(0, 1);
+
+    double xm = gig_mode(lambda, omega);
+    double x0 = omega / (1.0 - lambda);
+
+    double k0 = exp((lambda - 1.0) * log(xm) - 0.5 * omega * (xm + 1.0 / xm));
+    double A0 = k0 * x0;
+    double k1, A1, k2, A2;
+
+    if (x0 >= 2.0 / omega)
+    {
+        k1 = 0.0;
+        A1 = 0.0;
+        k2 = pow(x0, lambda - 1.0);
+        A2 = k2 * 2.0 * exp(-omega * x0 / 2.0) / omega;
+    }
+    else
+    {
+        k1 = exp(-omega);
+        A1 = (lambda == 0.0) ? k1 * log(2.0 / (omega * omega)) : k1 / lambda * (pow(2.0 / omega, lambda) - pow(x0, lambda));
+        k2 = pow(2.0 / omega, lambda - 1.0);
+        A2 = k2 * 2.0 * exp(-1.0) / omega;
+    }
 
-        if ((psi == 0)&&(eta < 0)&&(chi > 0)) 
+    double A = A0 + A1 + A2;
+    double V, X, hx;
+    while (true)
+    {
+        V = A * udist(gen);
+        if (V <= A0)
         {
-            // cout << "case 1" << endl;
-            std::gamma_distribution gammadist(-eta, 2/chi);  // if psi == 0, its a inverse gamma distribution invGamma(-eta, chi/2)
-            return 1 / gammadist(gen);
-        } else if ((chi == 0)&&(eta > 0)&&(psi > 0)) 
+            // region (0, x0)
+            X = x0 * V / A0;
+            hx = k0;
+        }
+        else if (V <= A0 + A1)
         {
-            // cout << "case 2" << endl;
-            std::gamma_distribution gammadist(eta, 2/psi);  // if chi == 0, it's Gamma(eta, psi/2)
-            return gammadist(gen);
-        } else if ((lambda < 1)&&(lambda >= 0)&&(beta <= sqrt(1-lambda)*2/3)) {
-            // cout << "case 3" << endl;
-            /////////////// Rejection method for non-T-concave part ///////////////////////
-            // source: https://core.ac.uk/download/pdf/11008021.pdf
-            double k1, k2, k3, A1, A2, A3, A, h;
-            double m = beta / ((1-lambda) + sqrt(pow(1-lambda, 2) + pow(beta, 2)));
-            double x0 = beta / (1-lambda);
-            double xs = x0 > 2/beta ? x0 : 2/beta;
-            k1 = exp( (lambda-1)*log(m) - beta * (m + 1/m) / 2 ); // g(m) = x^(eta-1)*exp(-beta * (m+1/m) / 2)
-            A1 = k1 * x0;
-
-            if (x0 < 2/beta) {
-                k2 = exp(-beta);
-                if (lambda == 0) { A2 = k2 * log(2 / pow(beta, 2)); }
-                else { A2 = k2 * (pow(2/beta, lambda) - pow(x0, lambda)) / lambda; }
-            }else{  k2 = 0; A2 = 0; }
-            
-            k3 = pow(xs, lambda - 1); A3 = 2 * k3 * exp(-xs * beta / 2) / beta;
-            A = A1 + A2 + A3;
-
-            while (num_try < 1000){
-                u = udist(gen); v = udist(gen) * A;
-                if (v <= A1) { x = x0 * v / A1; h = k1; }
-                else if (v <= (A1 + A2)) {
-                    v = v - A1;
-                    if (lambda == 0) { x = beta * exp(v * exp(beta)); }
-                    else { x = pow( pow(x0, lambda) + v * lambda / k2, 1/lambda ); h = k2 * pow(x, lambda - 1);  }
-                } else {
-                    v = v - A1 - A2;
-                    x = - 2 / beta * log( exp( -xs * beta / 2) - v * beta / 2 / k3 ); 
-                    h = k3 * exp(-x * beta / 2);
-                }
-                if (u * h <= exp( (lambda - 1)*log(x) - beta * (x + 1/x) / 2 ) ) 
-                {   // uh <= g(x, eta, chi , psi)
-                    // ret = eta >= 0 ? x : 1/x;
-                    // return ret;
-                    break;
-                } else { num_try += 1; }
-            }
-            // cout << "Warning: Sampling lambda exceeds 1000 iterations in rejection methhod for non-T-concave part" << endl;
-            // cout << "eta = " << eta << "; chi = " << chi << "; psi = " << psi << endl; 
-            // cout << "c = " << c << "; d = " << d << "; n = " << n << "; sy = " << sy << endl;
-            // cout << "k1 = " << k1 << "; k2 = " << k2 << "; k3 = " << k3 << endl;
-            // cout << "A1 = " << A1 << "; A2 = " << A2 << "; A3 = " << A3 << "; x = " << x << endl;
-
-            cout << "case 3 eta " << eta << " x " << x << " 1/x " << 1/x << endl;
-            ret = eta >= 0 ? x : 1/x;
-            return ret;
-        } else if ((lambda <= 1)&&(lambda >= 0)&&(beta <= 1)&&((beta >= 1/2) | (beta >= sqrt(1-lambda)*2/3))){
-            // cout << "case 4" << endl;
-            /////////////// Ratio-of-Uniforms without node shift ///////////////////////
-            // source: https://core.ac.uk/download/pdf/11008021.pdf
-            double m = beta / ((1-lambda) + sqrt((pow(1-lambda, 2) + pow(beta, 2))));
-            double xp = ((1+lambda) + sqrt(pow(1+lambda, 2) + pow(beta, 2))) / beta;
-            double vp = sqrt( exp( (lambda-1)*log(m) - beta * (m + 1/m) / 2 ) ); // sqrt(g(m))
-            double up = xp * sqrt( exp( (lambda - 1)*log(xp) - beta * (xp + 1/xp) /2 ));
-
-            while (num_try < 1000){
-                u = udist(gen) * up; v = udist(gen) * vp;
-                x = u/v;
-                if (pow(v, 2) <= exp( (lambda-1)*log(x) - beta * (x + 1/x) /2 )) { return x;}
-                else { num_try += 1; } 
-            }
-            // cout << "Warning: Sampling lambda exceeds 1000 iterations in ratio-of-uniforms without mode shift" << endl;
-            // cout << "eta = " << eta << "; chi = " << chi << "; psi = " << psi << endl; 
-            // cout << "c = " << c << "; d = " << d << "; n = " << n << "; sy = " << sy << endl;
-            // cout << "m = " << m << "; xp = " << xp << "; vp = " << vp << "; up = " << up << "; x = " << x << endl;
-            cout << "case 4 eta " << eta << " x " << x << " 1/x " << 1/x << endl;
-            ret = eta >= 0 ? x : 1/x;
-            return ret;
-        } else if ((lambda > 1) && (beta > 1))
-        { 
-            /////////////// Ratio-of-Uniforms method ///////////////////////        
-            double bx, dx, logib, logid, logu1, logu2;
-            bx = sqrt(pow(lambda, 2) - 2*lambda + chi * psi + 1) + lambda - 1 == 0 ? chi/(2-2*lambda) : (sqrt(pow(lambda, 2) - 2*lambda + chi * psi + 1) + lambda - 1) / psi;
-            dx = sqrt(pow(lambda, 2) + 2*lambda + chi * psi + 1) + lambda + 1 == 0 ? -chi / (2 * lambda + 2) : (sqrt(pow(lambda, 2) + 2*lambda + chi * psi + 1) + lambda + 1) / psi;
-            // ib = sqrt(exp(lgigkernel(bx, eta, chi, psi)));
-            // id = dx * sqrt(exp(lgigkernel(dx, eta, chi, psi)));
-            logib = 1/2 * lgigkernel(bx, lambda, chi, psi);
-            logid = log(dx) + 1/2 * lgigkernel(dx, lambda, chi, psi);
-            // u2 / u1 = exp(log(u2) - log(u1)) = exp(log(u) + log(ib) - log(u) - log(id))
-            // log(ib) = log(exp(lgigkernel(bx, -)))^1/2) = 1/2 * lgigkernel(bx, -);
-
-            // if bx or dx is less than 0, likely psi is too closed to zero and caused an rounding error.
-            // if ((bx <= 0 | dx <= 0 | id <= 0 | ib <= 0) && (eta < 0)) return 1/gen.gamma(-eta, chi);
-            
-            while (num_try < 1000)
+            // region (x0, 2/omega)
+            V -= A0;
+            if (lambda == 0.0)
             {
-                // u1 = udist(gen)*ib;
-                // u2 = udist(gen)*id;
-                logu1 = log(udist(gen)) + logib;
-                logu2 = log(udist(gen)) + logid;
-                if (isinf(logu1) | isinf(logu2) | isnan(logu1) | isnan(logu2)) {
-                    cout << "logu1 = " << logu1 << "; logu2 = " << logu2 << endl;
-                    cout << "bx = " << bx << "; logib = " << logib << "; dx = " << dx << "; logid = " << logid << endl;
-                    cout << "eta = " << eta << "; chi = " << chi << "; psi = " << psi << endl; 
-                    cout << "c = " << c << "; d = " << d << "; n = " << n << "; sy = " << sy << endl;
-                    exit(1);
-                    }
-                if (2*logu1 <= lgigkernel(exp(logu2 - logu1), lambda, chi, psi)) {
-                    ret = exp(logu2 - logu1);
-                    cout << "case 5 iter " << num_try << " eta " << eta << " ret " << ret << endl;
-                    cout << "logu1 = " << logu1 << "; logu2 = " << logu2 << endl;
-                    cout << "bx = " << bx << "; logib = " << logib << "; dx = " << dx << "; logid = " << logid << endl;
-                    cout << "eta = " << eta << "; chi = " << chi << "; psi = " << psi << endl; 
-                    return ret; 
-                } else {num_try += 1;}
+                X = omega * exp(exp(omega) * V);
+                hx = k1 / X;
             }
-    
-            // When psi is extremely small and the sampling can not converge, it will eventually cause overflows
-            // So we try to consider psi as the case psi == 0 
-            if (eta < 0) 
+            else
             {
-                // cout << "case 5" << endl;
-                std::gamma_distribution gammadist(-eta, 2/chi);  // if psi == 0, its a inverse gamma distribution invGamma(-eta, chi/2)
-                ret = 1 / gammadist(gen);
-                ret = exp(logu2 - logu1);
-                cout << "case 5 invGamma eta " << eta << " ret " << ret << endl;
-                return ret; 
-            } else {
-                // cout << "case 6" << endl;
-                // cout << "Warning: Sampling lambda exceeds 1000 iterations." << endl;
-                // cout << "logu1 = " << logu1 << "; logu2 = " << logu2 << endl;
-                // cout << "logbx = " << bx << "; logib = " << logib << "; dx = " << dx << "; logid = " << logid << endl;
-                // cout << "eta = " << eta << "; chi = " << chi << "; psi = " << psi << endl; 
-                // cout << "c = " << c << "; d = " << d << "; n = " << n << "; sy = " << sy << endl;
-                // cout << "u2 / u1 = " << exp(logu2 - logu1) << endl;
-                ret = exp(logu2 - logu1);
-                cout << "case 6 eta " <<  eta  << " ret " << ret << endl;
-                return ret; 
+                X = pow(pow(x0, lambda) + (lambda / k1 * V), 1.0 / lambda);
+                hx = k1 * pow(X, lambda - 1.0);
             }
-        } else if ((eta < 0) && (psi < 1)) {
-            std::gamma_distribution gammadist(-eta, 2/chi);  // if psi == 0, its a inverse gamma distribution invGamma(-eta, chi/2)
-            ret = 1 / gammadist(gen);
-            cout << "Warning psi is too small, treat as inverse gamma distribution, return " << ret << endl;
-            return ret;
-        } else {
-            cout << "Currently can not sample " << " eta = " << eta << " chi = " << chi << " psi = " << psi << " beta = " << beta << endl;
-            exit(1);
         }
-    } else { 
-        // draw from gig(c+r, 0, 2*(d+s)) or equivalently gamma(c+r, d+s)
-        // cout << "draw from gamma" << endl;
-        std::gamma_distribution gammadist(c+n, d+sy);  
+        else
+        {
+            // region (max(x0, 2/omega), infinity)
+            V -= A0 + A1;
+            double a = (x0 > 2.0 / omega) ? x0 : 2.0 / omega;
+            X = -2.0 / omega * log(exp(-omega / 2.0 * a) - omega / (2.0 * k2) * V);
+            hx = k2 * exp(-omega / 2.0 * X);
+        }
+
+        if (log(udist(gen) * hx) <= (lambda - 1.0) * log(X) - omega / 2.0 * (X + 1.0 / X))
+        {
+            return X;
+        }
+    }
+}
+
+double rgig(double lambda, double chi, double psi, std::mt19937 &gen)
+{
+    // draw from GIG(lambda, chi, psi)
+    const double ztol = 10.0 * std::numeric_limits<double>::epsilon();
+
+    if (chi < ztol)
+    {
+        // Gamma(lambda, psi/2)
+        if (lambda <= 0.0 || psi <= 0.0)
+        {
+            throw std::range_error("invalid parameters of generalized inverse Gaussian distribution");
+        }
+        std::gamma_distribution<double> gammadist(lambda, 2.0 / psi);
         return gammadist(gen);
     }
+
+    if (psi < ztol)
+    {
+        // inverse Gamma(-lambda, chi/2)
+        if (lambda >= 0.0 || chi <= 0.0)
+        {
+            throw std::range_error("invalid parameters of generalized inverse Gaussian distribution");
+        }
+        std::gamma_distribution<double> gammadist(-lambda, 2.0 / chi);
+        return 1.0 / gammadist(gen);
+    }
+
+    // X ~ GIG(|lambda|, omega, omega), then alpha * X ~ GIG(|lambda|, chi, psi) and alpha / X ~ GIG(-|lambda|, chi, psi)
+    double abs_lambda = fabs(lambda);
+    double alpha = sqrt(chi / psi);
+    double omega = sqrt(psi * chi);
+    double X;
+
+    if (abs_lambda > 2.0 || omega > 3.0)
+    {
+        X = rgig_ROU_shift(abs_lambda, omega, gen);
+    }
+    else if (abs_lambda >= 1.0 - 2.25 * omega * omega || omega > 0.2)
+    {
+        X = rgig_ROU_noshift(abs_lambda, omega, gen);
+    }
+    else
+    {
+        X = rgig_concave(abs_lambda, omega, gen);
+    }
+
+    return lambda < 0.0 ? alpha / X : alpha * X;
 }
 
 double gignorm(double eta, double chi, double psi) 
@@ -667,8 +703,198 @@ double loggignorm(double eta, double chi, double psi)
 }
 
 
+// orders at or above this use the uniform asymptotic expansion, below it the interpolation tables and forward recurrence
+static const double lbk_nu_asymptotic = 25.0;
+
+// interpolation grid on t = log(x), the tables are used for x in (lbk_x_min, lbk_x_max)
+// the last grid point is at or above log(lbk_x_max), so every x below it has a right neighbour in the table
+static const double lbk_x_min = 1e-6;
+static const double lbk_x_max = 1e6;
+static const double lbk_t_min = log(lbk_x_min);
+static const double lbk_t_step = 1.0 / 64.0;
+static const size_t lbk_grid_size = (size_t)ceil((log(lbk_x_max) - lbk_t_min) / lbk_t_step) + 1;
+
+log_bessel_k::log_bessel_k(double order)
+{
+    // |nu| for nu = order + k has one of two fractional parts
+    double mu1 = order - floor(order);
+    double mu2 = ceil(order) - order;
+
+    std::vector<double> mus = {mu1};
+    if (fabs(mu2 - mu1) > 1e-12)
+    {
+        mus.push_back(mu2);
+    }
+
+    for (double mu : mus)
+    {
+        table tab;
+        tab.mu = mu;
+        tab.g0.resize(lbk_grid_size);
+        tab.dg0.resize(lbk_grid_size);
+        tab.g1.resize(lbk_grid_size);
+        tab.dg1.resize(lbk_grid_size);
+
+        for (size_t i = 0; i < lbk_grid_size; i++)
+        {
+            double x = exp(lbk_t_min + i * lbk_t_step);
+            double lk_prev = gsl_sf_bessel_lnKnu(fabs(mu - 1.0), x); // K_{mu - 1} = K_{1 - mu}
+            double lk0 = gsl_sf_bessel_lnKnu(mu, x);
+            double lk1 = gsl_sf_bessel_lnKnu(mu + 1.0, x);
+
+            // d log K_nu(e^t) / dt = -x K_{nu - 1}(x) / K_nu(x) - nu
+            tab.g0[i] = lk0 + x;
+            tab.dg0[i] = x * (1.0 - exp(lk_prev - lk0)) - mu;
+            tab.g1[i] = lk1 + x;
+            tab.dg1[i] = x * (1.0 - exp(lk0 - lk1)) - (mu + 1.0);
+        }
+
+        tables.push_back(tab);
+    }
+}
+
+double log_bessel_k::evaluate_table(const table &tab, size_t k, double x) const
+{
+    double s = (log(x) - lbk_t_min) / lbk_t_step;
+    size_t i = (size_t)s;
+    double u = s - i;
+
+    // cubic Hermite basis
+    double h00 = (1.0 + 2.0 * u) * (1.0 - u) * (1.0 - u);
+    double h10 = u * (1.0 - u) * (1.0 - u) * lbk_t_step;
+    double h01 = u * u * (3.0 - 2.0 * u);
+    double h11 = u * u * (u - 1.0) * lbk_t_step;
+
+    double g0 = h00 * tab.g0[i] + h10 * tab.dg0[i] + h01 * tab.g0[i + 1] + h11 * tab.dg0[i + 1];
+    if (k == 0)
+    {
+        return g0 - x;
+    }
+
+    double g1 = h00 * tab.g1[i] + h10 * tab.dg1[i] + h01 * tab.g1[i + 1] + h11 * tab.dg1[i + 1];
+
+    // forward recurrence on the ratio r_j = K_{mu + j + 1} / K_{mu + j}, which is stable for K
+    // K_{nu + 1} = K_{nu - 1} + 2 nu / x K_nu
+    double r = exp(g1 - g0);
+    double prod = r;
+    double log_prod = 0.0;
+    for (size_t j = 1; j < k; j++)
+    {
+        r = 1.0 / r + 2.0 * (tab.mu + j) / x;
+        prod *= r;
+        if (prod > 1e280)
+        {
+            log_prod += log(prod);
+            prod = 1.0;
+        }
+    }
+
+    return g0 - x + log_prod + log(prod);
+}
+
+double log_bessel_k::evaluate(double nu, double x) const
+{
+    // K_{-nu} = K_nu
+    nu = fabs(nu);
+
+    if (nu >= lbk_nu_asymptotic)
+    {
+        return log_bessel_k_asymptotic(nu, x);
+    }
+
+    if (x > lbk_x_min && x < lbk_x_max)
+    {
+        for (auto &tab : tables)
+        {
+            double k = round(nu - tab.mu);
+            if (k >= 0 && fabs(nu - tab.mu - k) < 1e-9)
+            {
+                return evaluate_table(tab, (size_t)k, x);
+            }
+        }
+    }
+
+    return gsl_sf_bessel_lnKnu(nu, x);
+}
+
+double log_bessel_k_asymptotic(double nu, double x)
+{
+    // uniform asymptotic expansion of K_nu(nu * z) for large nu, Abramowitz and Stegun 9.7.8, terms up to u_4(t)
+    double z = x / nu;
+    double s = sqrt(1.0 + z * z);
+    double eta = s + log(z / (1.0 + s));
+
+    double t = 1.0 / s;
+    double t2 = t * t;
+    double t4 = t2 * t2;
+    double u1 = t * (3.0 - 5.0 * t2) / 24.0;
+    double u2 = t2 * (81.0 - 462.0 * t2 + 385.0 * t4) / 1152.0;
+    double u3 = t * t2 * (30375.0 - 369603.0 * t2 + 765765.0 * t4 - 425425.0 * t2 * t4) / 414720.0;
+    double u4 = t4 * (4465125.0 - 94121676.0 * t2 + 349922430.0 * t4 - 446185740.0 * t2 * t4 + 185910725.0 * t4 * t4) / 39813120.0;
+
+    double inv = 1.0 / nu;
+    double series = 1.0 + inv * (-u1 + inv * (u2 + inv * (-u3 + inv * u4)));
+
+    return 0.5 * log(M_PI / (2.0 * nu)) - nu * eta - 0.5 * log(s) + log(series);
+}
+
+double loggignorm(double eta, double chi, double psi, const log_bessel_k &lbk)
+{
+    // same as loggignorm, with log K_eta from the precomputed evaluator
+    double ret;
+    if ((eta > 0) && (chi == 0) && (psi > 0))
+    {
+        ret = lgamma(eta) + eta * log(2 / psi);
+    }
+    else if ((eta < 0) && (chi > 0) && (psi == 0))
+    {
+        ret = (lgamma(-eta) - eta * log(2 / chi));
+    }
+    else if ((chi > 0) && (psi > 0))
+    {
+        ret = (log(2) + lbk.evaluate(eta, sqrt(chi * psi)) - (eta / 2) * log(psi / chi));
+    }
+    return ret;
+}
+
 double lgigkernel(double x, double eta, double chi, double psi)
 {
     // return pow(x, eta-1)*exp(-(chi/x + psi*x)/2);
     return (eta-1)*log(x) - (chi/x + psi*x)/2;
-}
\ No newline at end of file
+}
+
+philox4x32::philox4x32(uint64_t key, uint32_t stream0, uint32_t stream1, uint32_t stream2)
+{
+    this->key[0] = (uint32_t)key;
+    this->key[1] = (uint32_t)(key >> 32);
+    this->counter[0] = 0;
+    this->counter[1] = stream0;
+    this->counter[2] = stream1;
+    this->counter[3] = stream2;
+    this->index = 4;
+}
+
+void philox4x32::block(const uint32_t *counter, const uint32_t *key, uint32_t *output)
+{
+    const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    uint64_t p0, p1;
+    for (size_t round = 0; round < 10; round++)
+    {
+        p0 = (uint64_t)M0 * c0;
+        p1 = (uint64_t)M1 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += W0;
+        k1 += W1;
+    }
+    output[0] = c0;
+    output[1] = c1;
+    output[2] = c2;
+    output[3] = c3;
+    return;
+}
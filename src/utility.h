@@ -53,6 +53,10 @@ double sum_squared(std::vector<double> &v);
 
 double sum_vec(std::vector<double> &v);
 
+void log_sum_exp_normalize(double *x, size_t n);
+
+void vec_quantile(std::vector<double> &v, const std::vector<double> &probs, std::vector<double> &output);
+
 void seq_gen_std(size_t start, size_t end, size_t length_out, std::vector<size_t> &vec);
 
 void seq_gen_std2(size_t start, size_t end, size_t length_out, std::vector<size_t> &vec);
@@ -145,7 +149,8 @@ double sq_vec_diff_sizet(std::vector<size_t> &v1, std::vector<size_t> &v2);
 
 void unique_value_count2(const double *Xpointer, matrix<size_t> &Xorder_std, std::vector<double> &X_values, std::vector<size_t> &X_counts, std::vector<size_t> &variable_ind, size_t &total_points, std::vector<size_t> &X_num_unique, std::vector<size_t> &X_num_cutpoints, size_t &p_categorical, size_t &p_continuous);
 
-void get_X_range(const double *Xpointer, std::vector<std::vector<size_t>> &Xorder_std, std::vector<std::vector<double>> &X_range, size_t &n_y);
+// merge rows N_old to N - 1 into the presorted order of the first N_old rows, X is column major N by p
+void merge_xorder_std(const double *Xpointer, size_t N, size_t N_old, matrix<size_t> &Xorder_std);
 
 double normal_density(double y, double mean, double var, bool take_log);
 
@@ -161,6 +166,9 @@ void dirichlet_distribution(std::vector<double> &prob, std::vector<double> &alph
 
 void get_rel_covariance(mat &cov, mat &X, std::vector<double> X_range, double theta, double tau);
 
+// cross covariance between rows of X1 and rows of X2, same kernel as get_rel_covariance
+void get_rel_cross_covariance(mat &cov, mat &X1, mat &X2, std::vector<double> &X_range, double theta, double tau);
+
 double sum_vec_yz(std::vector<double> &v, matrix<double> &z);
 
 double sum_vec_z_squared(matrix<double> &z, size_t n);
@@ -169,14 +177,89 @@ double sum_vec_yzsq(std::vector<double> &v, matrix<double> &z);
 
 double sum_vec_y_z(std::vector<double> &v, matrix<double> &z);
 
-double drawlambdafromR(size_t n, double sy, double c, double d, std::mt19937& gen);
+double drawlambda(size_t n, double sy, double c, double d, std::mt19937 &gen);
 
-double drawnodelambda(size_t n, double sy, double c, double d, std::mt19937& gen);
+double rgig(double lambda, double chi, double psi, std::mt19937 &gen);
 
 double gignorm(double eta, double chi, double psi);
 
 double loggignorm(double eta, double chi, double psi) ;
 
+class log_bessel_k
+{
+    // fast evaluation of log K_nu(x), the modified Bessel function of the second kind
+    // orders nu = order + k (k integer) are looked up from interpolation tables of K_mu, K_{mu + 1} and forward recurrence,
+    // large orders use the uniform asymptotic expansion, everything else falls back to GSL
+public:
+    log_bessel_k() {}
+
+    log_bessel_k(double order);
+
+    double evaluate(double nu, double x) const;
+
+private:
+    struct table
+    {
+        // g(t) = log K(e^t) + e^t on a grid of t = log(x), and dg / dt for cubic Hermite interpolation
+        double mu;
+        std::vector<double> g0, dg0, g1, dg1;
+    };
+
+    std::vector<table> tables;
+
+    double evaluate_table(const table &tab, size_t k, double x) const;
+};
+
+double log_bessel_k_asymptotic(double nu, double x);
+
+double loggignorm(double eta, double chi, double psi, const log_bessel_k &lbk);
+
 double lgigkernel(double x, double eta, double chi, double psi);
 
+class philox4x32
+{
+    // counter-based random number generator, Philox4x32-10 (Salmon et al. 2011)
+    // the output stream is a pure function of (key, stream), independent streams for parallel tasks are created
+    // by keying with the seed and giving each task its own stream id, e.g. (sweep, tree, block)
+    // satisfies UniformRandomBitGenerator, usable with the std:: distributions
+public:
+    typedef uint32_t result_type;
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    philox4x32(uint64_t key, uint32_t stream0 = 0, uint32_t stream1 = 0, uint32_t stream2 = 0);
+
+    result_type operator()()
+    {
+        if (index == 4)
+        {
+            generate();
+            counter[0]++;
+            index = 0;
+        }
+        return output[index++];
+    }
+
+    void discard(unsigned long long z)
+    {
+        for (unsigned long long i = 0; i < z; i++)
+        {
+            (*this)();
+        }
+    }
+
+    // one block of four outputs for a given counter and key
+    static void block(const uint32_t *counter, const uint32_t *key, uint32_t *output);
+
+private:
+    uint32_t key[2];
+    uint32_t counter[4]; // counter[0] advances per block, counter[1..3] hold the stream id
+    uint32_t output[4];
+    size_t index;
+
+    void generate() { block(counter, key, output); }
+};
+
 #endif
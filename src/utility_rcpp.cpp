@@ -112,6 +112,56 @@ void rcpp_to_std2(arma::mat &y, arma::mat &X, std::vector<double> &y_std, double
     return;
 }
 
+void rcpp_to_std2_append(arma::mat &y, arma::mat &X, arma::mat &Xorder_old, std::vector<double> &y_std, double &y_mean, Rcpp::NumericMatrix &X_std, matrix<size_t> &Xorder_std)
+{
+    // same as rcpp_to_std2, but the first rows of X are already sorted by a previous fit
+    // the remaining rows are merged into that order instead of sorting every column again
+    size_t N = X.n_rows;
+    size_t p = X.n_cols;
+    size_t N_old = Xorder_old.n_rows;
+
+    if (Xorder_old.n_cols != p || N_old > N)
+    {
+        Rcpp::stop("Xorder of the previous fit does not match X");
+    }
+
+    for (size_t i = 0; i < N; i++)
+    {
+        y_std[i] = y(i, 0);
+        y_mean = y_mean + y_std[i];
+    }
+    y_mean = y_mean / (double)N;
+
+    for (size_t i = 0; i < N; i++)
+    {
+        for (size_t j = 0; j < p; j++)
+        {
+            X_std(i, j) = X(i, j);
+        }
+    }
+
+    // every column must be a permutation of 0, ..., N_old - 1, the entries index rows of X
+    std::vector<bool> seen(N_old);
+    double index;
+    for (size_t j = 0; j < p; j++)
+    {
+        std::fill(seen.begin(), seen.end(), false);
+        for (size_t i = 0; i < N_old; i++)
+        {
+            index = Xorder_old(i, j);
+            if (!(index >= 0 && index < (double)N_old) || index != std::floor(index) || seen[(size_t)index])
+            {
+                Rcpp::stop("Xorder of the previous fit is not a permutation of its rows");
+            }
+            seen[(size_t)index] = true;
+            Xorder_std[j][i] = (size_t)index;
+        }
+    }
+    merge_xorder_std(&X_std[0], N, N_old, Xorder_std);
+
+    return;
+}
+
 void rcpp_to_std2(arma::mat &X, Rcpp::NumericMatrix &X_std, matrix<size_t> &Xorder_std)
 {
     // The goal of this function is to convert RCPP object to std objects
@@ -0,0 +1,140 @@
+###################################################
+# tests of the standalone scoring server, run by test_server.sh
+#
+# python test_server.py server_binary model.json reference.txt
+# reference.txt has one testing row per line, features followed by the posterior mean of predict.XBART
+###################################################
+
+import json
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import unittest
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "server"))
+import xbart_client
+
+SERVER, MODEL, REFERENCE = sys.argv[1:4]
+
+
+def start_server(args):
+	process = subprocess.Popen([SERVER] + args, stdout = subprocess.PIPE, universal_newlines = True)
+	output = ""
+	while "listening" not in output:
+		line = process.stdout.readline()
+		if not line:
+			raise RuntimeError("server did not start: " + output)
+		output += line
+	return process, output
+
+
+def connect(path):
+	sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+	sock.connect(path)
+	return sock
+
+
+class ServerTesting(unittest.TestCase):
+
+	@classmethod
+	def setUpClass(cls):
+		cls.directory = tempfile.mkdtemp()
+		cls.socket_path = os.path.join(cls.directory, "xbart.sock")
+		cls.binary_model = os.path.join(cls.directory, "model.bin")
+		subprocess.check_call([SERVER, "--model", MODEL, "--convert", cls.binary_model], stdout = subprocess.DEVNULL)
+
+		# the same model saved before the number of training columns was recorded
+		cls.legacy_model = os.path.join(cls.directory, "legacy.json")
+		with open(MODEL) as f:
+			model = json.load(f)
+		model.pop("p", None)
+		with open(cls.legacy_model, "w") as f:
+			json.dump(model, f)
+
+		# json model is model 0, its binary conversion model 1, the legacy model 2, one worker only
+		cls.server, output = start_server(["--model", MODEL, "--model", cls.binary_model, "--model", cls.legacy_model,
+			"--socket", cls.socket_path, "--threads", "1", "--max-rows", "100", "--timeout", "2"])
+
+		with open(REFERENCE) as f:
+			rows = [[float(v) for v in line.split()] for line in f if line.strip()]
+		cls.x = [row[:-1] for row in rows]
+		cls.p = len(cls.x[0])
+		cls.reference = [row[-1] for row in rows]
+
+	@classmethod
+	def tearDownClass(cls):
+		cls.server.send_signal(signal.SIGTERM)
+		cls.server.wait(10)
+
+	def test_binary_roundtrip(self):
+		sock = connect(self.socket_path)
+		json_draws = xbart_client.request(sock, xbart_client.OP_DRAWS, self.x, model = 0)
+		binary_draws = xbart_client.request(sock, xbart_client.OP_DRAWS, self.x, model = 1)
+		mean = xbart_client.request(sock, xbart_client.OP_MEAN, self.x, model = 1)
+		sock.close()
+
+		self.assertEqual(json_draws, binary_draws)
+		for i in range(len(self.x)):
+			self.assertAlmostEqual(mean[i][0], self.reference[i], places = 6)
+
+	def test_idle_connection_does_not_hold_worker(self):
+		idle = connect(self.socket_path)
+		time.sleep(0.2)
+		sock = connect(self.socket_path)
+		sock.settimeout(1)
+		self.assertEqual(len(xbart_client.request(sock, xbart_client.OP_MEAN, self.x)), len(self.x))
+		sock.close()
+		idle.close()
+
+	def test_bad_requests(self):
+		# oversized request, wrong number of columns and unknown model are rejected before reading values
+		for n_rows, p, model in [(2 ** 31, self.p, 0), (1, self.p + 1, 0), (1, self.p + 1, 1), (1, self.p, 3)]:
+			sock = connect(self.socket_path)
+			sock.sendall(struct.pack("=5I", xbart_client.REQUEST_MAGIC, xbart_client.OP_MEAN, model, n_rows, p))
+			status, n_rows, n_cols = struct.unpack("=3I", xbart_client._recv_all(sock, 12))
+			self.assertEqual(status, 1)
+			self.assertEqual(sock.recv(1), b"")
+			sock.close()
+
+		# the server is still running
+		sock = connect(self.socket_path)
+		self.assertEqual(len(xbart_client.request(sock, xbart_client.OP_MEAN, self.x)), len(self.x))
+		sock.close()
+
+	def test_legacy_model_accepts_wider_rows(self):
+		# without the number of training columns any row covering the split variables is scored
+		sock = connect(self.socket_path)
+		mean = xbart_client.request(sock, xbart_client.OP_MEAN, self.x, model = 2)
+		wider = xbart_client.request(sock, xbart_client.OP_MEAN, [row + [0.0] for row in self.x], model = 2)
+		sock.close()
+
+		self.assertEqual(mean, wider)
+		for i in range(len(self.x)):
+			self.assertAlmostEqual(mean[i][0], self.reference[i], places = 6)
+
+	def test_stalled_request_times_out(self):
+		sock = connect(self.socket_path)
+		sock.sendall(struct.pack("=3I", xbart_client.REQUEST_MAGIC, xbart_client.OP_MEAN, 0))
+		sock.settimeout(5)
+		self.assertEqual(sock.recv(1), b"")
+		sock.close()
+
+	def test_corrupted_model_is_rejected(self):
+		with open(self.binary_model, "rb") as f:
+			data = f.read()
+		broken = os.path.join(self.directory, "broken.bin")
+		for size in [0, 40, 60, len(data) // 2, len(data) - 8]:
+			with open(broken, "wb") as f:
+				f.write(data[:size])
+			code = subprocess.call([SERVER, "--model", broken, "--socket", os.path.join(self.directory, "broken.sock")],
+				stdout = subprocess.DEVNULL, timeout = 10)
+			self.assertEqual(code, 1)
+
+
+if __name__ == "__main__":
+	unittest.main(argv = sys.argv[:1])
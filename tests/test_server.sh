@@ -0,0 +1,25 @@
+#! /bin/bash
+# build the scoring server, fit a small model in R and test the server against predict.XBART
+set -e
+echo Building server
+cd ../server
+bash build_server.sh
+cd ../tests
+
+echo Fitting model
+Rscript -e '
+library(XBART)
+set.seed(1)
+n <- 2000
+p <- 4
+X <- matrix(rnorm(n * p), n, p)
+y <- sin(X[, 1]) + X[, 2]^2 + X[, 3] * X[, 4] + rnorm(n, 0, 0.3)
+fit <- XBART(y, X, num_trees = 10, num_sweeps = 5, burnin = 0L, parallel = FALSE, random_seed = 1)
+writeLines(fit$tree_json, "server_model.json")
+Xtest <- matrix(rnorm(20 * p), 20, p)
+write.table(cbind(Xtest, rowMeans(predict(fit, Xtest))), "server_reference.txt", row.names = FALSE, col.names = FALSE)
+'
+
+echo Testing server
+python test_server.py ../server/xbart_server server_model.json server_reference.txt
+rm -f server_model.json server_reference.txt